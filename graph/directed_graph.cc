@@ -39,9 +39,7 @@ edge_descriptor directed_graph::add_edge(int s, int t)
 {
 	assert(s >= 0 && s < vv.size());
 	assert(t >= 0 && t < vv.size());
-	edge_base *e = new edge_base(s, t);
-	assert(se.find(e) == se.end());
-	se.insert(e);
+	edge_base *e = new_edge(s, t);
 	vv[s]->add_out_edge(e);
 	vv[t]->add_in_edge(e);
 	return e;
@@ -52,8 +50,7 @@ int directed_graph::remove_edge(edge_descriptor e)
 	if(se.find(e) == se.end()) return -1;
 	vv[e->source()]->remove_out_edge(e);
 	vv[e->target()]->remove_in_edge(e);
-	delete e;
-	se.erase(e);
+	delete_edge(e);
 	return 0;
 }
 
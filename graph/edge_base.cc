@@ -10,7 +10,11 @@ See LICENSE for licensing.
 using namespace std;
 
 edge_base::edge_base(int _s, int _t)
-	:s(_s), t(_t)
+	:s(_s), t(_t), i(-1)
+{}
+
+edge_base::edge_base(int _s, int _t, int _i)
+	:s(_s), t(_t), i(_i)
 {}
 
 int edge_base::move(int x, int y)
@@ -38,6 +42,11 @@ int edge_base::target() const
 	return t;
 }
 
+int edge_base::index() const
+{
+	return i;
+}
+
 int edge_base::print() const
 {
 	printf("edge %d -> %d\n", s, t);
@@ -18,16 +18,19 @@ class edge_base
 {
 public:
 	edge_base(int _s, int _t);
+	edge_base(int _s, int _t, int _i);
 
 protected:
 	int s;					// source
 	int t;					// target
+	int i;					// index in its graph, never reused while the graph lives
 
 public:
 	virtual int move(int x, int y);
 	virtual int swap();
 	virtual int source() const;
 	virtual int target() const;
+	int index() const;
 	virtual int print() const;
 };
 
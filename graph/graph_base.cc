@@ -76,6 +76,24 @@ int graph_base::clear()
 	}
 	vv.clear();
 	se.clear();
+	ev.clear();
+	return 0;
+}
+
+edge_descriptor graph_base::new_edge(int s, int t)
+{
+	edge_base *e = new edge_base(s, t, ev.size());
+	ev.push_back(e);
+	se.insert(e);
+	return e;
+}
+
+int graph_base::delete_edge(edge_descriptor e)
+{
+	assert(e->index() >= 0 && e->index() < ev.size());
+	ev[e->index()] = NULL;
+	se.erase(e);
+	delete e;
 	return 0;
 }
 
@@ -151,6 +169,17 @@ size_t graph_base::num_edges() const
 	return se.size();
 }
 
+size_t graph_base::num_edge_indices() const
+{
+	return ev.size();
+}
+
+edge_descriptor graph_base::get_edge(int i) const
+{
+	if(i < 0 || i >= ev.size()) return null_edge;
+	return ev[i];
+}
+
 int graph_base::get_edge_indices(VE &i2e, MEI &e2i)
 {
 	i2e.clear();
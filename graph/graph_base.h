@@ -38,6 +38,7 @@ public:
 protected:
 	vector<vertex_base*> vv;
 	set<edge_base*> se;
+	vector<edge_base*> ev;		// edges by index, NULL once removed
 
 public:
 	// modify the graph
@@ -60,6 +61,8 @@ public:
 	virtual set<int> adjacent_vertices(int v);
 	virtual PEEI out_edges(int x) = 0;
 	virtual int get_edge_indices(VE &e2i, MEI &i2e);
+	virtual size_t num_edge_indices() const;
+	virtual edge_descriptor get_edge(int i) const;
 
 	// algorithms
 	virtual int bfs(int s, vector<int> &v);
@@ -75,6 +78,10 @@ public:
 	// draw
 	virtual int draw(const string &file, const MIS &mis, const MES &mes, double len, bool footer) = 0;
 	virtual int print() const;
+
+protected:
+	edge_descriptor new_edge(int s, int t);
+	int delete_edge(edge_descriptor e);
 };
 
 #endif
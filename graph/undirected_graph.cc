@@ -37,9 +37,7 @@ edge_descriptor undirected_graph::add_edge(int s, int t)
 {
 	assert(s >= 0 && s < vv.size());
 	assert(t >= 0 && t < vv.size());
-	edge_base *e = new edge_base(s, t);
-	assert(se.find(e) == se.end());
-	se.insert(e);
+	edge_base *e = new_edge(s, t);
 	vv[s]->add_out_edge(e);
 	vv[t]->add_out_edge(e);
 	return e;
@@ -50,8 +48,7 @@ int undirected_graph::remove_edge(edge_descriptor e)
 	if(se.find(e) == se.end()) return -1;
 	vv[e->source()]->remove_out_edge(e);
 	vv[e->target()]->remove_out_edge(e);
-	delete e;
-	se.erase(e);
+	delete_edge(e);
 	return 0;
 }
 
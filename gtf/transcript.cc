@@ -352,3 +352,49 @@ int transcript::write(ostream &fout, double cov2, int count) const
 	}
 	return 0;
 }
+
+int transcript::save(ostream &os) const
+{
+	write_binary_string(os, seqname);
+	write_binary_string(os, source);
+	write_binary_string(os, feature);
+	write_binary_string(os, gene_id);
+	write_binary_string(os, transcript_id);
+	write_binary_string(os, gene_type);
+	write_binary_string(os, transcript_type);
+	write_binary(os, start);
+	write_binary(os, end);
+	write_binary(os, score);
+	write_binary(os, strand);
+	write_binary(os, frame);
+	write_binary(os, coverage);
+	write_binary(os, covratio);
+	write_binary(os, RPKM);
+	write_binary(os, FPKM);
+	write_binary(os, TPM);
+	write_binary_vector(os, exons);
+	return 0;
+}
+
+int transcript::load(istream &is)
+{
+	read_binary_string(is, seqname);
+	read_binary_string(is, source);
+	read_binary_string(is, feature);
+	read_binary_string(is, gene_id);
+	read_binary_string(is, transcript_id);
+	read_binary_string(is, gene_type);
+	read_binary_string(is, transcript_type);
+	read_binary(is, start);
+	read_binary(is, end);
+	read_binary(is, score);
+	read_binary(is, strand);
+	read_binary(is, frame);
+	read_binary(is, coverage);
+	read_binary(is, covratio);
+	read_binary(is, RPKM);
+	read_binary(is, FPKM);
+	read_binary(is, TPM);
+	read_binary_vector(is, exons);
+	return 0;
+}
@@ -71,6 +71,8 @@ public:
 	int extend_bounds(const transcript &t);
 	string label() const;
 	int write(ostream &fout, double cov2 = -1, int count = -1) const;
+	int save(ostream &os) const;		// binary, for stored results
+	int load(istream &is);
 };
 
 #endif
@@ -29,27 +29,27 @@ assembler::assembler(const parameters &p)
 {
 }
 
-int assembler::resolve(vector<bundle*> gv, transcript_set &ts, int instance)
+int assembler::resolve(vector<bundle*> gv, transcript_set &ts, int32_t window, int instance)
 {
 	int subindex = 0;
 
 	if(gv.size() == 1)
 	{
 		bundle &bd = *(gv[0]);
-		assemble(bd, ts, instance);
+		assemble(bd, ts, window, instance);
 	}
 
 	if(gv.size() >= 2)
 	{
 		bridge(gv);
-		assemble(gv, ts, instance);
+		assemble(gv, ts, window, instance);
 	}
 	return 0;
 }
 
-int assembler::assemble(bundle &bd, transcript_set &ts, int instance)
+int assembler::assemble(bundle &bd, transcript_set &ts, int32_t window, int instance)
 {
-	bd.set_gid(instance, 0);
+	bd.set_gid(window, instance, 0);
 	splice_graph gr;
 	transform(bd, gr, true);
 
@@ -59,7 +59,7 @@ int assembler::assemble(bundle &bd, transcript_set &ts, int instance)
 	return 0;
 }
 
-int assembler::assemble(vector<bundle*> gv, transcript_set &ts, int instance)
+int assembler::assemble(vector<bundle*> gv, transcript_set &ts, int32_t window, int instance)
 {
 	assert(gv.size() >= 2);
 	int subindex = 0;
@@ -67,8 +67,8 @@ int assembler::assemble(vector<bundle*> gv, transcript_set &ts, int instance)
 	// combined bundle
 	bundle bx(cfg, gv[0]->sp);
 	bx.copy_meta_information(*(gv[0]));
-	for(int k = 0; k < gv.size(); k++) bx.combine(*(gv[k]));
-	bx.set_gid(instance, subindex++);
+	bx.combine(gv);
+	bx.set_gid(window, instance, subindex++);
 
 	// combined graph
 	splice_graph gx;
@@ -81,7 +81,7 @@ int assembler::assemble(vector<bundle*> gv, transcript_set &ts, int instance)
 	for(int k = 0; k < gv.size(); k++)
 	{
 		bundle &bd = *(gv[k]);
-		bd.set_gid(instance, subindex++);
+		bd.set_gid(window, instance, subindex++);
 
 		splice_graph gr;
 		transform(bd, gr, true);
@@ -121,7 +121,7 @@ int assembler::bridge(vector<bundle*> gv)
 	// construct combined bundle
 	bundle cb(cfg, gv[0]->sp);
 	cb.copy_meta_information(*(gv[0]));
-	for(int k = 0; k < gv.size(); k++) cb.combine(*(gv[k]));
+	cb.combine(gv);
 
 	// construct combined graph
 	splice_graph gr;
@@ -22,9 +22,9 @@ public:
 	const parameters &cfg;
 
 public:
-	int resolve(vector<bundle*> gv, transcript_set &ts, int instance);
-	int assemble(bundle &cb, transcript_set &ts, int instance);
-	int assemble(vector<bundle*> gv, transcript_set &ts, int instance);
+	int resolve(vector<bundle*> gv, transcript_set &ts, int32_t window, int instance);
+	int assemble(bundle &cb, transcript_set &ts, int32_t window, int instance);
+	int assemble(vector<bundle*> gv, transcript_set &ts, int32_t window, int instance);
 	int assemble(splice_graph &gx, phase_set &px, transcript_set &ts, int sid);
 	int transform(bundle &cb, splice_graph &gr, bool revising);
 	int bridge(vector<bundle*> gv);
@@ -18,18 +18,22 @@ bundle::bundle(const parameters &c, const sample_profile &s)
 	: cfg(c), sp(s)
 {
 	num_combined = 0;
+	spill_offset = -1;
+	memory = 0;
 }
 
 bundle::bundle(const parameters &c, const sample_profile &s, bundle_base &&bb)
-	: cfg(c), sp(s), bundle_base(bb)
+	: cfg(c), sp(s), bundle_base(std::move(bb))
 {
 	num_combined = 0;
+	spill_offset = -1;
+	memory = 0;
 }
 
-int bundle::set_gid(int instance, int subindex)
+int bundle::set_gid(int32_t window, int instance, int subindex)
 {
 	char name[10240];
-	sprintf(name, "instance.%d.%d", instance, subindex);
+	sprintf(name, "instance.%d.%d.%d", window, instance, subindex);
 	gid = name;
 	return 0;
 }
@@ -46,30 +50,227 @@ int bundle::copy_meta_information(const bundle &bb)
 
 int bundle::bridge()
 {
+	// a fragment left unbridged only sees the graph between its mates, so it
+	// can change outcome only if a later round bridges something touching it;
+	// such stable fragments are still clustered and counted, but clusters
+	// made only of them are not solved again
+	vector<PI32> spans(frgs.size(), PI32(0, -1));	// genomic extents of pending fragments
+	vector<PI32> dirty;								// genomic extents of clusters bridged last round
+	vector<bool> retired(frgs.size(), false);		// stable fragments not re-solved on their own
+
+	// alignments are reported only when the sample writes them and names are kept
+	bool report = (keep_qnames == true && sp.bridged_bam_file != "");
+	vector<bam1_t*> vb;
+
+	int rounds = 0;
+	int total = 0;
+	int solved = 0;
+	int skipped = 0;
 	while(true)
 	{
+		if(rounds >= 1)
+		{
+			skipped += retire_stable_fragments(spans, dirty, retired);
+			if(dirty.size() == 0) break;
+		}
+
 		splice_graph gr;
 		graph_builder gb(*this, cfg, sp);
 		gb.build(gr);
 		gr.build_vertex_index();
 
 		vector<pereads_cluster> vc;
-		graph_cluster gc(gr, *this, cfg.max_reads_partition_gap, false);
+		graph_cluster gc(gr, *this, cfg.max_reads_partition_gap, report, retired);
 		gc.build_pereads_clusters(vc);
 
 		bridge_solver bs(gr, vc, cfg, sp.insertsize_low, sp.insertsize_high);
 
+		rounds++;
+		dirty.clear();
 		int cnt = 0;
 		assert(vc.size() == bs.opt.size());
 		for(int k = 0; k < vc.size(); k++)
 		{
-			if(bs.opt[k].type <= 0) continue;
-			cnt += update_bridges(vc[k].frlist, bs.opt[k].chain);
+			// cover both the hits and the exons they were aligned to
+			int32_t l = min(vc[k].bounds[0], vc[k].extend[0]);
+			int32_t r = max(vc[k].bounds[3], vc[k].extend[3]);
+
+			solved += vc[k].frlist.size();
+			int c = 0;
+			if(bs.opt[k].type >= 1) c = update_bridges(vc[k].frlist, bs.opt[k].chain);
+			if(c >= 1) dirty.push_back(PI32(l, r));
+			if(c >= 1 && report == true) build_bridged_reads(vc[k], bs.opt[k].whole, vb);
+			cnt += c;
+
+			for(int j = 0; j < vc[k].frlist.size(); j++)
+			{
+				int f = vc[k].frlist[j];
+				if(frgs[f][2] == 0) spans[f] = PI32(l, r);
+			}
 		}
 
+		total += cnt;
 		//printf("total frags %lu, bridged frags = %d\n", bb.frgs.size(), cnt);
 		if(cnt <= 0) break;
 	}
+
+	if(report == true)
+	{
+		build_unbridged_reads(vb);
+		sp.open_bridged_bam()->write(vb);
+	}
+
+	if(cfg.verbose >= 2 && rounds >= 2)
+	{
+		printf("bridge bundle %s:%d-%d: %d rounds, %d fragments bridged, %d fragments re-solved, %d stable fragments skipped\n", 
+				chrm.c_str(), lpos, rpos, rounds, total, solved, skipped);
+	}
+	return 0;
+}
+
+int bundle::build_bridged_reads(const pereads_cluster &pc, const vector<int32_t> &whole, vector<bam1_t*> &vb)
+{
+	// one record spanning both mates for each fragment bridged by this cluster
+	assert(pc.hits1.size() == pc.frlist.size());
+	for(int j = 0; j < pc.frlist.size(); j++)
+	{
+		if(frgs[pc.frlist[j]][2] <= 0) continue;
+		bam1_t *b1t = bam_init1();
+		bool b = build_bam1_t(*b1t, pc.hits1[j], pc.hits2[j], whole);
+		if(b == true) vb.push_back(b1t);
+		else bam_destroy1(b1t);
+	}
+	return 0;
+}
+
+int bundle::build_unbridged_reads(vector<bam1_t*> &vb)
+{
+	// every other hit is reported with its own splices
+	vector<bool> bridged(hits.size(), false);
+	for(int i = 0; i < frgs.size(); i++)
+	{
+		if(frgs[i][2] <= 0) continue;
+		bridged[frgs[i][0]] = true;
+		bridged[frgs[i][1]] = true;
+	}
+
+	for(int i = 0; i < hits.size(); i++)
+	{
+		if(bridged[i] == true) continue;
+		if(hits[i].hid < 0) continue;
+		bam1_t *b1t = bam_init1();
+		bool b = build_bam1_t(*b1t, hit_core(hits[i], get_qname(i)), hcst.get_chain(i));
+		if(b == true) vb.push_back(b1t);
+		else bam_destroy1(b1t);
+	}
+	return 0;
+}
+
+int bundle::retire_stable_fragments(const vector<PI32> &spans, vector<PI32> &dirty, vector<bool> &retired)
+{
+	// merge touching extents; shared boundaries count since vertices there may change
+	sort(dirty.begin(), dirty.end());
+	vector<PI32> vv;
+	for(int i = 0; i < dirty.size(); i++)
+	{
+		if(vv.size() >= 1 && dirty[i].first <= vv.back().second) vv.back().second = max(vv.back().second, dirty[i].second);
+		else vv.push_back(dirty[i]);
+	}
+
+	int cnt = 0;
+	int pending = 0;
+	for(int i = 0; i < frgs.size(); i++)
+	{
+		if(frgs[i][2] != 0) continue;
+		if(retired[i] == true) continue;
+
+		const PI32 &p = spans[i];
+		if(p.first > p.second)
+		{
+			pending++;
+			continue;
+		}
+
+		vector<PI32>::iterator it = upper_bound(vv.begin(), vv.end(), PI32(p.second, INT32_MAX));
+		if(it != vv.begin() && (--it)->second >= p.first)
+		{
+			pending++;
+			continue;
+		}
+
+		retired[i] = true;	// same result as last round
+		cnt++;
+	}
+
+	if(pending <= 0) dirty.clear();
+	return cnt;
+}
+
+int bundle::spill(ofstream &fout, const string &file)
+{
+	build_coverage();
+	memory = estimate_memory();
+	splices = hcst.get_splices();
+	spill_file = file;
+	spill_offset = fout.tellp();
+	write(fout);
+	release();
+	return 0;
+}
+
+int bundle::reload()
+{
+	if(spill_file == "") return 0;
+
+	// records are read in place from the mapped file
+	std::shared_ptr<mapped_file> mf = store;
+	if(mf == NULL) mf = mapped_file::open(spill_file);
+	if(mf == NULL || spill_offset < 0 || spill_offset > mf->size)
+	{
+		printf("cannot open spilled bundles %s\n", spill_file.c_str());
+		exit(0);
+	}
+
+	memory_buffer mb(mf->data + spill_offset, mf->size - spill_offset);
+	istream is(&mb);
+	if(read(is) != 0)
+	{
+		printf("corrupt or truncated bundle at offset %ld of %s\n", spill_offset, spill_file.c_str());
+		exit(0);
+	}
+
+	spill_file = "";
+	spill_offset = -1;
+	splices.clear();
+	store.reset();
+	return 0;
+}
+
+int64_t bundle::estimate_memory() const
+{
+	// hits dominate the resident size of a bundle
+	if(spill_file != "") return memory;
+	int64_t m = 0;
+	m += hits.size() * sizeof(hit);
+	m += qnames.size();
+	m += frgs.size() * (sizeof(AI3) + sizeof(int));
+	return m;
+}
+
+vector<int32_t> bundle::get_splices() const
+{
+	if(spill_file != "") return splices;
+	return hcst.get_splices();
+}
+
+int bundle::clear()
+{
+	bundle_base::clear();
+	splices.clear();
+	spill_file = "";
+	spill_offset = -1;
+	memory = 0;
+	store.reset();
 	return 0;
 }
 
@@ -83,7 +284,36 @@ int bundle::combine(const bundle &bb)
 	if(rpos < bb.rpos) rpos = bb.rpos;
 	hcst.add(bb.hcst);
 	fcst.add(bb.fcst);
-	for(SIMI z = bb.mmap.begin(); z != bb.mmap.end(); z++) mmap += *z;
-	for(SIMI z = bb.imap.begin(); z != bb.imap.end(); z++) imap += *z;
+	mmap.add(bb.mmap);
+	imap.add(bb.imap);
+	return 0;
+}
+
+int bundle::combine(const vector<bundle*> &gv)
+{
+	// merge coverage of all bundles in one sweep
+	vector<const coverage_map*> vm;
+	vector<const coverage_map*> vi;
+	vector<const chain_set*> vh;
+	vector<const chain_set*> vf;
+	for(int k = 0; k < gv.size(); k++)
+	{
+		gv[k]->build_coverage();
+		const bundle &bb = *(gv[k]);
+		num_combined += bb.num_combined;
+		assert(strand == bb.strand);
+		assert(chrm == bb.chrm);
+		assert(tid == bb.tid);
+		if(lpos > bb.lpos) lpos = bb.lpos;
+		if(rpos < bb.rpos) rpos = bb.rpos;
+		vh.push_back(&(bb.hcst));
+		vf.push_back(&(bb.fcst));
+		vm.push_back(&(bb.mmap));
+		vi.push_back(&(bb.imap));
+	}
+	chain_set::merge(vh, hcst);
+	chain_set::merge(vf, fcst);
+	coverage_map::merge(vm, mmap);
+	coverage_map::merge(vi, imap);
 	return 0;
 }
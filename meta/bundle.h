@@ -11,10 +11,14 @@ See LICENSE for licensing.
 #include <stdint.h>
 #include <iostream>
 #include <string>
+#include <fstream>
+#include <memory>
 
 #include "parameters.h"
 #include "bundle_base.h"
 #include "sample_profile.h"
+#include "mapped_file.h"
+#include "pereads_cluster.h"
 
 using namespace std;
 
@@ -31,12 +35,25 @@ public:
 	const sample_profile &sp;
 	int num_combined;
 	string gid;
+	vector<int32_t> splices;			// kept when reads are spilled
+	string spill_file;					// file with spilled reads, empty if resident
+	int64_t spill_offset;				// offset of this bundle in spill_file
+	int64_t memory;						// resident size of reads, recorded when spilled
+	std::shared_ptr<mapped_file> store;	// keeps a loaded bundle store mapped
 
 public:
-	int set_gid(int instance, int subindex);
+	int set_gid(int32_t window, int instance, int subindex);
 	int copy_meta_information(const bundle &bb);
 	int combine(const bundle &bb);
+	int combine(const vector<bundle*> &gv);
 	int bridge();
+	int build_bridged_reads(const pereads_cluster &pc, const vector<int32_t> &whole, vector<bam1_t*> &vb);
+	int build_unbridged_reads(vector<bam1_t*> &vb);
+	int retire_stable_fragments(const vector<PI32> &spans, vector<PI32> &dirty, vector<bool> &retired);
+	int spill(ofstream &fout, const string &file);
+	int reload();
+	int64_t estimate_memory() const;
+	vector<int32_t> get_splices() const;
 	int print(int index);
 	int clear();
 };
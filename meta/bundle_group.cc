@@ -7,13 +7,14 @@ See LICENSE for licensing.
 #include <algorithm>
 #include <sstream>
 #include <fstream>
+#include <cmath>
+#include <memory>
+#include <functional>
 #include "bundle_group.h"
 #include "parameters.h"
 #include <boost/asio/post.hpp>
 #include <boost/asio/thread_pool.hpp>
 
-mutex bundle_group::gmutex;
-
 bundle_group::bundle_group(string c, char s, const parameters &f)
 	: cfg(f)
 {
@@ -21,74 +22,168 @@ bundle_group::bundle_group(string c, char s, const parameters &f)
 	strand = s;
 }
 
-int bundle_group::resolve()
+// run the tasks on the pool; the last one to finish runs next,
+// so no pool thread ever blocks on other tasks
+static int post_stage(boost::asio::thread_pool &pool, vector<function<void()>> &tasks, function<void()> next)
+{
+	if(tasks.size() == 0)
+	{
+		next();
+		return 0;
+	}
+
+	std::shared_ptr<atomic<int>> n(new atomic<int>(tasks.size()));
+	for(int i = 0; i < tasks.size(); i++)
+	{
+		function<void()> f = std::move(tasks[i]);
+		boost::asio::post(pool, [f, n, next]{ f(); if(--(*n) == 0) next(); });
+	}
+	return 0;
+}
+
+grouping_state::grouping_state(int n)
+	: ds(n)
+{
+	t0 = std::chrono::steady_clock::now();
+}
+
+double grouping_state::lap()
+{
+	auto t = std::chrono::steady_clock::now();
+	double d = std::chrono::duration<double>(t - t0).count();
+	t0 = t;
+	return d;
+}
+
+int bundle_group::resolve(boost::asio::thread_pool &pool, task_group &tg)
+{
+	std::shared_ptr<grouping_state> gs(new grouping_state(gset.size()));
+	boost::asio::post(pool, [this, &pool, &tg, gs]{ this->build_candidates(pool, tg, gs); });
+	return 0;
+}
+
+int bundle_group::build_candidates(boost::asio::thread_pool &pool, task_group &tg, std::shared_ptr<grouping_state> gs)
 {
 	grouped.assign(gset.size(), false);
 
 	build_splices();
 	build_splice_index();
+	build_prefix_index(*gs);
+
+	// score each candidate pair exactly once, in parallel over chunks
+	int nt = cfg.max_threads;
+	if(nt <= 0) nt = 1;
+	int m = ceil(1.0 * gset.size() / nt);
+	gs->vp.resize(nt);
+	gs->vs.resize(nt);
+
+	vector<function<void()>> tasks;
+	for(int k = 0; k < nt; k++)
+	{
+		int a = k * m;
+		int b = (k + 1) * m;
+		if(b > gset.size()) b = gset.size();
+		if(a >= b) continue;
+		grouping_state *g = gs.get();
+		tasks.push_back([this, a, b, g, k]{ this->score_candidates(a, b, g->prefix, g->tindex, g->vp[k], g->vs[k]); });
+	}
+	post_stage(pool, tasks, [this, &pool, &tg, gs]{ this->group_round1(pool, tg, gs); });
+	return 0;
+}
 
-	// round one
+int bundle_group::group_round1(boost::asio::thread_pool &pool, task_group &tg, std::shared_ptr<grouping_state> gs)
+{
+	collect_candidates(*gs);
+	gs->time_candidates = gs->lap();
+
+	// each bucket (graphs sharing a splice) sees the
+	// scored pairs that share this splice;
+	// buckets of this group share its lock
 	min_similarity = cfg.max_grouping_similarity;
 	min_group_size = cfg.max_group_size;
-	boost::asio::thread_pool pool1(cfg.max_threads);
+
+	vector<function<void()>> tasks;
+	grouping_state *g = gs.get();
 	for(auto &z: sindex)
 	{
 		const set<int> &s = z.second;
-		boost::asio::post(pool1, [this, &s]{ this->process_subset1(s); });
+		auto it = pindex.find(z.first);
+		const vector<int> &pv = (it == pindex.end()) ? g->empty : it->second;
+		if(pv.size() == 0 && min_group_size > 1) continue;
+		tasks.push_back([this, &s, &pv, g]{ this->process_subset1(s, pv, g->glock); });
 	}
-	pool1.join();
+	post_stage(pool, tasks, [this, &pool, &tg, gs]{ this->group_round2(pool, tg, gs); });
+	return 0;
+}
+
+int bundle_group::group_round2(boost::asio::thread_pool &pool, task_group &tg, std::shared_ptr<grouping_state> gs)
+{
 	stats(1);
+	gs->time_round1 = gs->lap();
 
-	// round two
-	disjoint_set ds(gset.size());
+	// round two, lock-free on the shared disjoint set
 	min_similarity = cfg.min_grouping_similarity;
 	min_group_size = 1;
-	boost::asio::thread_pool pool2(cfg.max_threads);
+
+	vector<function<void()>> tasks;
+	grouping_state *g = gs.get();
 	for(auto &z: sindex)
 	{
 		const set<int> &s = z.second;
-		boost::asio::post(pool2, [this, &s, &ds]{ this->process_subset2(s, ds); });
+		auto it = pindex.find(z.first);
+		if(it == pindex.end()) continue;
+		const vector<int> &pv = it->second;
+		tasks.push_back([this, &s, &pv, g]{ this->process_subset2(s, pv, g->ds); });
 	}
-	pool2.join();
-	build_groups(ds);
+	post_stage(pool, tasks, [this, &tg, gs]{ this->finish_groups(tg, gs); });
+	return 0;
+}
+
+int bundle_group::finish_groups(task_group &tg, std::shared_ptr<grouping_state> gs)
+{
+	build_groups(gs->ds);
 	stats(2);
+	gs->time_round2 = gs->lap();
+
+	if(cfg.verbose >= 1) printf("resolve group: chrm %s, strand %c, %lu graphs, %lu pairs, candidates %.3lf, round 1 %.3lf, round 2 %.3lf seconds\n",
+			chrm.c_str(), strand, gset.size(), vpairs.size(), gs->time_candidates, gs->time_round1, gs->time_round2);
 
 	sindex.clear();
+	pindex.clear();
+	vpairs.clear();
+	tg.finish();
 	return 0;
 }
 
-int bundle_group::process_subset1(const set<int> &s)
+int bundle_group::process_subset1(const set<int> &s, const vector<int> &pv, mutex &glock)
 {
-	gmutex.lock();
+	glock.lock();
 	vector<int> ss = filter(s);
-	gmutex.unlock();
+	glock.unlock();
 
 	vector<PPID> vpid;
-	build_similarity(ss, vpid, true);
+	build_similarity(ss, pv, vpid, true);
 
-	gmutex.lock();
+	glock.lock();
 	vector<PPID> v = filter(ss, vpid);
 	disjoint_set ds(ss.size());
 	augment_disjoint_set(v, ds);
 	build_groups(ss, ds);
-	gmutex.unlock();
+	glock.unlock();
 
 	return 0;
 }
 
-int bundle_group::process_subset2(const set<int> &s, disjoint_set &ds)
+int bundle_group::process_subset2(const set<int> &s, const vector<int> &pv, concurrent_disjoint_set &ds)
 {
+	// grouped is not modified in round two
 	vector<int> ss = filter(s);
 
 	vector<PPID> vpid;
-	build_similarity(ss, vpid, false);
+	build_similarity(ss, pv, vpid, false);
 
 	vector<PPID> v = filter(vpid);
-
-	gmutex.lock();
 	augment_disjoint_set(v, ds);
-	gmutex.unlock();
 
 	return 0;
 }
@@ -98,7 +193,7 @@ int bundle_group::build_splices()
 	splices.clear();
 	for(int i = 0; i < gset.size(); i++)
 	{
-		vector<int32_t> v = gset[i].hcst.get_splices();
+		vector<int32_t> v = gset[i].get_splices();
 		splices.push_back(std::move(v));
 	}
 	return 0;
@@ -128,35 +223,130 @@ int bundle_group::build_splice_index()
 	return 0;
 }
 
-int bundle_group::build_similarity(const vector<int> &ss, vector<PPID> &vpid, bool local)
+int bundle_group::build_prefix_index(grouping_state &gs)
 {
-	for(int xi = 0; xi < ss.size(); xi++)
+	vpairs.clear();
+	pindex.clear();
+
+	// pairs must reach the lower threshold of the two rounds
+	double t = min(cfg.min_grouping_similarity, cfg.max_grouping_similarity);
+
+	// prefix filtering: order splices by increasing frequency;
+	// two graphs with jaccard >= t and at least 2 common splices
+	// must share a splice within the prefixes below
+	gs.prefix.assign(gset.size(), vector<int32_t>());
+	gs.tindex.clear();
+	for(int i = 0; i < gset.size(); i++)
 	{
-		int i = ss[xi];
-		if(splices[i].size() / 2.0 > cfg.max_num_junctions_to_combine) continue;
-		for(int xj = 0; xj < ss.size(); xj++)
+		const vector<int32_t> &v = splices[i];
+		if(v.size() / 2.0 > cfg.max_num_junctions_to_combine) continue;
+
+		int o = (int)(ceil(t * v.size() - 0.000001));
+		if(o < 2) o = 2;
+		int n = (int)(v.size()) - o + 1;
+		if(n <= 0) continue;
+
+		vector<pair<int, int32_t>> z;
+		for(int k = 0; k < v.size(); k++) z.push_back(make_pair(sindex[v[k]].size(), v[k]));
+		sort(z.begin(), z.end());
+
+		for(int k = 0; k < n; k++)
 		{
-			int j = ss[xj];
-			if(i >= j) continue;
-			if(splices[j].size() / 2.0 > cfg.max_num_junctions_to_combine) continue;
+			gs.prefix[i].push_back(z[k].second);
+			gs.tindex[z[k].second].push_back(i);
+		}
+	}
+	return 0;
+}
 
+int bundle_group::collect_candidates(grouping_state &gs)
+{
+	for(int k = 0; k < gs.vp.size(); k++)
+	{
+		for(int i = 0; i < gs.vp[k].size(); i++)
+		{
+			const vector<int32_t> &v = gs.vs[k][i];
+			for(int j = 0; j < v.size(); j++) pindex[v[j]].push_back(vpairs.size());
+			vpairs.push_back(gs.vp[k][i]);
+		}
+	}
+
+	if(cfg.verbose >= 2) printf("build candidates: chrm %s, strand %c, %lu graphs, %lu prefix splices, %lu pairs\n",
+			chrm.c_str(), strand, gset.size(), gs.tindex.size(), vpairs.size());
+
+	gs.prefix.clear();
+	gs.tindex.clear();
+	gs.vp.clear();
+	gs.vs.clear();
+	return 0;
+}
+
+int bundle_group::score_candidates(int a, int b, const vector<vector<int32_t>> &prefix, const map<int32_t, vector<int>> &tindex, vector<PPID> &vp, vector<vector<int32_t>> &vs)
+{
+	double t = min(cfg.min_grouping_similarity, cfg.max_grouping_similarity);
+	vector<int> mark(gset.size(), -1);
+	for(int i = a; i < b; i++)
+	{
+		// candidates j > i sharing a prefix splice
+		vector<int> cand;
+		for(int k = 0; k < prefix[i].size(); k++)
+		{
+			const vector<int> &v = tindex.find(prefix[i][k])->second;
+			for(int x = upper_bound(v.begin(), v.end(), i) - v.begin(); x < v.size(); x++)
+			{
+				int j = v[x];
+				if(mark[j] == i) continue;
+				mark[j] = i;
+				cand.push_back(j);
+			}
+		}
+		sort(cand.begin(), cand.end());
+
+		for(int x = 0; x < cand.size(); x++)
+		{
+			int j = cand[x];
 			assert(gset[i].chrm == gset[j].chrm);
 			assert(gset[i].strand == gset[j].strand);
 
-			vector<int32_t> vv(splices[i].size() + splices[j].size(), 0);
+			int si = splices[i].size();
+			int sj = splices[j].size();
+			if(min(si, sj) < t * max(si, sj) - 0.000001) continue;
+
+			vector<int32_t> vv(min(si, sj), 0);
 			vector<int32_t>::iterator it = set_intersection(splices[i].begin(), splices[i].end(), splices[j].begin(), splices[j].end(), vv.begin());
 			int c = it - vv.begin();
-			double r = c * 1.0 / (splices[i].size() + splices[j].size() - c);
-
-			//printf("graph-similarity: b = %c, r = %.3lf, c = %d, size1 = %lu, size2 = %lu\n", b ? 'T' : 'F', r, c, splices[i].size(), splices[j].size());
+			double r = c * 1.0 / (si + sj - c);
 
 			if(c <= 1.50) continue;
-			if(r < min_similarity) continue;
+			if(r < t) continue;
 
-			if(local == true) vpid.push_back(PPID(PI(xi, xj), r));
-			else vpid.push_back(PPID(PI(i, j), r));
+			vv.resize(c);
+			vp.push_back(PPID(PI(i, j), r));
+			vs.push_back(std::move(vv));
 		}
 	}
+	return 0;
+}
+
+int bundle_group::build_similarity(const vector<int> &ss, const vector<int> &pv, vector<PPID> &vpid, bool local)
+{
+	// ss is sorted; keep the pairs with both graphs in ss
+	for(int k = 0; k < pv.size(); k++)
+	{
+		const PPID &p = vpairs[pv[k]];
+		double r = p.second;
+		if(r < min_similarity) continue;
+
+		int i = p.first.first;
+		int j = p.first.second;
+		vector<int>::const_iterator xi = lower_bound(ss.begin(), ss.end(), i);
+		if(xi == ss.end() || *xi != i) continue;
+		vector<int>::const_iterator xj = lower_bound(ss.begin(), ss.end(), j);
+		if(xj == ss.end() || *xj != j) continue;
+
+		if(local == true) vpid.push_back(PPID(PI(xi - ss.begin(), xj - ss.begin()), r));
+		else vpid.push_back(PPID(PI(i, j), r));
+	}
 
 	sort(vpid.begin(), vpid.end(), [](const PPID &x, const PPID &y){ return x.second > y.second; });
 
@@ -187,21 +377,51 @@ int bundle_group::augment_disjoint_set(const vector<PPID> &vpid, disjoint_set &d
 	return 0;
 }
 
-int bundle_group::build_groups(disjoint_set &ds)
+int bundle_group::augment_disjoint_set(const vector<PPID> &vpid, concurrent_disjoint_set &ds)
+{
+	for(int i = 0; i < vpid.size(); i++)
+	{
+		int x = vpid[i].first.first;
+		int y = vpid[i].first.second;
+		ds.link_capped(x, y, cfg.max_group_size);
+	}
+	return 0;
+}
+
+int bundle_group::build_groups(concurrent_disjoint_set &ds)
 {
 	vector<int> ss(gset.size());
-	for(int i = 0; i < ss.size(); i++) ss[i] = i;
-	build_groups(ss, ds);
+	vector<PI> rs(gset.size());
+	for(int i = 0; i < ss.size(); i++)
+	{
+		ss[i] = i;
+		int p = ds.find_set(i);
+		rs[i] = PI(p, ds.get_size(p));
+	}
+	build_groups(ss, rs);
 	return 0;
 }
 
 int bundle_group::build_groups(const vector<int> &ss, disjoint_set &ds)
 {
-	map<int, int> mm;
+	vector<PI> rs(ss.size());
 	for(int i = 0; i < ss.size(); i++)
 	{
 		int p = ds.find_set(i);
-		int s = ds.get_size(p);
+		rs[i] = PI(p, ds.get_size(p));
+	}
+	build_groups(ss, rs);
+	return 0;
+}
+
+int bundle_group::build_groups(const vector<int> &ss, const vector<PI> &rs)
+{
+	// rs[i] gives the root and size of the set of ss[i]
+	map<int, int> mm;
+	for(int i = 0; i < ss.size(); i++)
+	{
+		int p = rs[i].first;
+		int s = rs[i].second;
 		if(s < min_group_size) continue;
 		if(grouped[ss[i]] == true) continue;
 
@@ -272,6 +492,14 @@ int bundle_group::stats(int r)
 	return 0;
 }
 
+int64_t bundle_group::estimate_memory() const
+{
+	// spilled bundles count with the size they have once reloaded
+	int64_t m = 0;
+	for(int k = 0; k < gset.size(); k++) m += gset[k].estimate_memory();
+	return m;
+}
+
 int bundle_group::print()
 {
 	for(int k = 0; k < gvv.size(); k++)
@@ -9,9 +9,38 @@ See LICENSE for licensing.
 
 #include "parameters.h"
 #include "disjoint_set.h"
+#include "concurrent_disjoint_set.h"
 #include "bundle.h"
 #include "constants.h"
+#include "task_group.h"
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <boost/asio/thread_pool.hpp>
+
+// state of one resolving group, shared by its staged tasks
+class grouping_state
+{
+public:
+	grouping_state(int n);
+
+public:
+	vector<vector<int32_t>> prefix;				// prefix splices of graphs
+	map<int32_t, vector<int>> tindex;			// graphs indexed by prefix splices
+	vector<vector<PPID>> vp;					// scored pairs of chunks
+	vector<vector<vector<int32_t>>> vs;			// shared splices of the pairs
+	vector<int> empty;
+	mutex glock;								// lock for round one
+	concurrent_disjoint_set ds;					// disjoint set for round two
+	std::chrono::steady_clock::time_point t0;
+	double time_candidates;
+	double time_round1;
+	double time_round2;
+
+public:
+	double lap();
+};
 
 class bundle_group
 {
@@ -30,26 +59,37 @@ public:
 
 private:
 	MISI sindex;				// splice index
+	vector<PPID> vpairs;		// scored candidate pairs (i < j)
+	map<int32_t, vector<int>> pindex;	// pairs sharing each splice
 	vector<bool> grouped;		// track grouped graphs
-	static mutex gmutex;		// global mutex
 	double min_similarity;		// minimum similarity for this round
 	int min_group_size;			// minimum #graphs to form a group
 
 public:
 	//int add_graph(const bundle &gr);
-	int resolve();
+	int resolve(boost::asio::thread_pool &pool, task_group &tg);
 	int print();
 	int stats(int k);
+	int64_t estimate_memory() const;
 
 private:
 	int build_splices();
 	int build_splice_index();
-	int process_subset1(const set<int> &ss);
-	int process_subset2(const set<int> &ss, disjoint_set &ds);
-	int build_similarity(const vector<int> &ss, vector<PPID> &vpid, bool local);
+	int build_candidates(boost::asio::thread_pool &pool, task_group &tg, std::shared_ptr<grouping_state> gs);
+	int group_round1(boost::asio::thread_pool &pool, task_group &tg, std::shared_ptr<grouping_state> gs);
+	int group_round2(boost::asio::thread_pool &pool, task_group &tg, std::shared_ptr<grouping_state> gs);
+	int finish_groups(task_group &tg, std::shared_ptr<grouping_state> gs);
+	int build_prefix_index(grouping_state &gs);
+	int collect_candidates(grouping_state &gs);
+	int score_candidates(int a, int b, const vector<vector<int32_t>> &prefix, const map<int32_t, vector<int>> &tindex, vector<PPID> &vp, vector<vector<int32_t>> &vs);
+	int process_subset1(const set<int> &ss, const vector<int> &pv, mutex &glock);
+	int process_subset2(const set<int> &ss, const vector<int> &pv, concurrent_disjoint_set &ds);
+	int build_similarity(const vector<int> &ss, const vector<int> &pv, vector<PPID> &vpid, bool local);
 	int augment_disjoint_set(const vector<PPID> &vpid, disjoint_set &ds);
+	int augment_disjoint_set(const vector<PPID> &vpid, concurrent_disjoint_set &ds);
 	int build_groups(const vector<int> &ss, disjoint_set &ds);
-	int build_groups(disjoint_set &ds);
+	int build_groups(concurrent_disjoint_set &ds);
+	int build_groups(const vector<int> &ss, const vector<PI> &rs);
 	vector<PPID> filter(const vector<PPID> &vpid);
 	vector<PPID> filter(const vector<int> &ss, const vector<PPID> &vpid);
 	vector<int> filter(const set<int> &s);
@@ -0,0 +1,72 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#include "bundle_queue.h"
+
+bundle_job::bundle_job(bundle &&b)
+	: bd(std::move(b))
+{
+	state = 0;
+}
+
+bundle_queue::bundle_queue()
+{
+	waiting = 0;
+}
+
+int bundle_queue::push(bundle &&bd)
+{
+	lock_guard<mutex> lk(lock);
+	jobs.push_back(bundle_job(std::move(bd)));
+	waiting++;
+	return 0;
+}
+
+bool bundle_queue::bridge()
+{
+	unique_lock<mutex> lk(lock);
+	if(waiting <= 0) return false;
+
+	// elements of a deque stay in place when its ends change
+	bundle_job &bj = jobs[jobs.size() - waiting];
+	waiting--;
+	bj.state = 1;
+	lk.unlock();
+
+	bj.bd.build_fragments();
+	bj.bd.bridge();
+
+	lk.lock();
+	bj.state = 2;
+	cv.notify_all();
+	return true;
+}
+
+int bundle_queue::pop(vector<bundle> &v)
+{
+	lock_guard<mutex> lk(lock);
+	int n = 0;
+	while(jobs.size() >= 1 && jobs.front().state == 2)
+	{
+		v.push_back(std::move(jobs.front().bd));
+		jobs.pop_front();
+		n++;
+	}
+	return n;
+}
+
+int bundle_queue::wait()
+{
+	unique_lock<mutex> lk(lock);
+	cv.wait(lk, [this]{ return jobs.size() == 0 || jobs.front().state == 2; });
+	return 0;
+}
+
+int bundle_queue::size()
+{
+	lock_guard<mutex> lk(lock);
+	return jobs.size();
+}
@@ -0,0 +1,51 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#ifndef __BUNDLE_QUEUE_H__
+#define __BUNDLE_QUEUE_H__
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+#include "bundle.h"
+
+using namespace std;
+
+class bundle_job
+{
+public:
+	bundle_job(bundle &&bd);
+	bundle_job(bundle_job &&bj) = default;
+
+public:
+	bundle bd;
+	int state;						// 0: waiting, 1: bridging, 2: bridged
+};
+
+// closed bundles of one sample stream, bridged by any thread
+// and handed back to the reader in the order they were closed
+class bundle_queue
+{
+public:
+	bundle_queue();
+
+private:
+	deque<bundle_job> jobs;			// bundles in index order
+	int waiting;					// jobs at the back not yet claimed
+	mutex lock;
+	condition_variable cv;
+
+public:
+	int push(bundle &&bd);			// append a closed bundle
+	bool bridge();					// bridge the earliest waiting bundle, false if none
+	int pop(vector<bundle> &v);		// move leading bridged bundles into v
+	int wait();						// block until the first bundle is bridged
+	int size();						// bundles not yet popped
+};
+
+#endif
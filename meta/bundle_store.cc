@@ -0,0 +1,171 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#include "bundle_store.h"
+#include "mapped_file.h"
+#include "util.h"
+
+#include <cstdio>
+#include <cassert>
+
+#define STORE_MAGIC 0x53425341
+#define STORE_VERSION 6
+
+bundle_store::bundle_store(const sample_profile &s, int32_t l, int32_t r)
+	: sp(s), lpos(l), rpos(r)
+{
+}
+
+int bundle_store::write_index(ofstream &fout, const parameters &cfg, const vector<bundle> &v, const transcript_set &ts)
+{
+	int64_t offset = fout.tellp();
+
+	int64_t n = v.size();
+	write_binary(fout, n);
+	for(int i = 0; i < v.size(); i++)
+	{
+		const bundle &bd = v[i];
+		assert(bd.spill_offset >= 0);
+		write_binary_string(fout, bd.chrm);
+		write_binary(fout, bd.strand);
+		write_binary(fout, bd.tid);
+		write_binary(fout, bd.lpos);
+		write_binary(fout, bd.rpos);
+		write_binary_string(fout, bd.gid);
+		write_binary(fout, bd.num_combined);
+		write_binary(fout, bd.spill_offset);
+		write_binary(fout, bd.memory);
+		write_binary_vector(fout, bd.splices);
+	}
+	ts.write(fout);
+
+	// fixed-size trailer
+	uint64_t identity = sp.get_identity();
+	uint64_t settings = get_settings(cfg);
+	int32_t magic = STORE_MAGIC, version = STORE_VERSION;
+	write_binary(fout, offset);
+	write_binary(fout, identity);
+	write_binary(fout, settings);
+	write_binary(fout, lpos);
+	write_binary(fout, rpos);
+	write_binary(fout, version);
+	write_binary(fout, magic);
+	return 0;
+}
+
+bool bundle_store::load(const string &file, const parameters &cfg, vector<bundle> &v, transcript_set &ts)
+{
+	std::shared_ptr<mapped_file> mf = mapped_file::open(file);
+	if(mf == NULL) return false;
+
+	// stores of other files, windows or settings are not used
+	size_t tail = sizeof(int64_t) + 2 * sizeof(uint64_t) + 2 * sizeof(int32_t) + 2 * sizeof(int32_t);
+	if(mf->size < tail) return false;
+
+	int64_t offset;
+	uint64_t identity, settings;
+	int32_t l, r, version, magic;
+	memory_buffer mt(mf->data + mf->size - tail, tail);
+	istream it(&mt);
+	read_binary(it, offset);
+	read_binary(it, identity);
+	read_binary(it, settings);
+	read_binary(it, l);
+	read_binary(it, r);
+	read_binary(it, version);
+	read_binary(it, magic);
+
+	if(magic != STORE_MAGIC || version != STORE_VERSION) return false;
+	if(identity != sp.get_identity() || l != lpos || r != rpos) return false;
+	if(settings != get_settings(cfg))
+	{
+		printf("stored bundles %s were generated with other settings, ignored\n", file.c_str());
+		return false;
+	}
+	if(offset < 0 || offset > mf->size - tail) return false;
+
+	memory_buffer mb(mf->data + offset, mf->size - tail - offset);
+	istream is(&mb);
+
+	int64_t n = 0;
+	read_binary(is, n);
+	if(n < 0 || n > mf->size) return false;
+
+	vector<bundle> vb;
+	vb.reserve(n);
+	for(int64_t i = 0; i < n && is.good(); i++)
+	{
+		bundle bd(cfg, sp);
+		read_binary_string(is, bd.chrm);
+		read_binary(is, bd.strand);
+		read_binary(is, bd.tid);
+		read_binary(is, bd.lpos);
+		read_binary(is, bd.rpos);
+		read_binary_string(is, bd.gid);
+		read_binary(is, bd.num_combined);
+		read_binary(is, bd.spill_offset);
+		read_binary(is, bd.memory);
+		read_binary_vector(is, bd.splices);
+		bd.spill_file = file;
+		bd.store = mf;
+		vb.push_back(std::move(bd));
+	}
+
+	transcript_set tt(ts.chrm, ts.single_exon_overlap);
+	tt.read(is);
+	if(is.fail()) return false;
+
+	// the sample may be at another position of the list now
+	map<int, int> m;
+	for(auto &x : tt.mt)
+	{
+		for(int k = 0; k < x.second.size(); k++)
+		{
+			for(auto &p : x.second[k].samples) m[p.first] = sp.sample_id;
+		}
+	}
+	tt.remap_samples(m);
+
+	for(int i = 0; i < vb.size(); i++) v.push_back(std::move(vb[i]));
+	ts = std::move(tt);
+	return true;
+}
+
+uint64_t bundle_store::get_settings(const parameters &cfg) const
+{
+	// everything that decides which reads form the bundles and how they are bridged
+	bool keep_qnames = (cfg.output_bridged_bam_dir != "");
+	bool weighted = (cfg.weighted_hits == true && keep_qnames == false);
+
+	string key;
+	key.append((const char*)(&cfg.min_mapping_quality), sizeof(cfg.min_mapping_quality));
+	key.append((const char*)(&cfg.max_num_cigar), sizeof(cfg.max_num_cigar));
+	key.append((const char*)(&cfg.use_second_alignment), sizeof(cfg.use_second_alignment));
+	key.append((const char*)(&cfg.uniquely_mapped_only), sizeof(cfg.uniquely_mapped_only));
+	key.append((const char*)(&cfg.min_bundle_gap), sizeof(cfg.min_bundle_gap));
+	key.append((const char*)(&weighted), sizeof(weighted));
+	key.append((const char*)(&keep_qnames), sizeof(keep_qnames));
+	key.append((const char*)(&cfg.min_junction_support), sizeof(cfg.min_junction_support));
+	key.append((const char*)(&cfg.normal_junction_threshold), sizeof(cfg.normal_junction_threshold));
+	key.append((const char*)(&cfg.extend_junction_threshold), sizeof(cfg.extend_junction_threshold));
+	key.append((const char*)(&cfg.min_guaranteed_edge_weight), sizeof(cfg.min_guaranteed_edge_weight));
+	key.append((const char*)(&cfg.max_reads_partition_gap), sizeof(cfg.max_reads_partition_gap));
+	key.append((const char*)(&cfg.bridge_end_relaxing), sizeof(cfg.bridge_end_relaxing));
+	key.append((const char*)(&cfg.bridge_dp_solution_size), sizeof(cfg.bridge_dp_solution_size));
+	key.append((const char*)(&cfg.bridge_dp_stack_size), sizeof(cfg.bridge_dp_stack_size));
+	key.append((const char*)(&cfg.min_bridging_score), sizeof(cfg.min_bridging_score));
+	key.append((const char*)(&sp.library_type), sizeof(sp.library_type));
+	key.append((const char*)(&sp.insertsize_low), sizeof(sp.insertsize_low));
+	key.append((const char*)(&sp.insertsize_high), sizeof(sp.insertsize_high));
+
+	uint64_t x = 14695981039346656037ULL;
+	for(int i = 0; i < key.size(); i++)
+	{
+		x ^= (uint8_t)(key[i]);
+		x *= 1099511628211ULL;
+	}
+	return x;
+}
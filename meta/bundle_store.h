@@ -0,0 +1,43 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#ifndef __BUNDLE_STORE_H__
+#define __BUNDLE_STORE_H__
+
+#include <vector>
+#include <string>
+#include <fstream>
+
+#include "bundle.h"
+#include "transcript_set.h"
+#include "sample_profile.h"
+#include "parameters.h"
+
+using namespace std;
+
+// bundles of one (sample, window) kept on disk after generating and
+// bridging; the file holds the records in the spill format, followed
+// by an index of the bundles (with their splices and resident sizes), the transcripts
+// assembled in step 1, and a trailer identifying the sample, the window
+// and the settings the bundles were generated and bridged with;
+// a loaded store is mapped, and bundles are read in place when assembled
+class bundle_store
+{
+public:
+	bundle_store(const sample_profile &sp, int32_t lpos, int32_t rpos);
+
+private:
+	const sample_profile &sp;
+	int32_t lpos;
+	int32_t rpos;
+
+public:
+	int write_index(ofstream &fout, const parameters &cfg, const vector<bundle> &v, const transcript_set &ts);
+	bool load(const string &file, const parameters &cfg, vector<bundle> &v, transcript_set &ts);
+	uint64_t get_settings(const parameters &cfg) const;
+};
+
+#endif
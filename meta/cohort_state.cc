@@ -0,0 +1,160 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#include "cohort_state.h"
+#include "util.h"
+
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+
+#define STATE_MAGIC 0x53435341
+#define STATE_VERSION 2
+
+cohort_state::cohort_state(const string &chrm, double overlap)
+	: tmerge(chrm, overlap)
+{
+	loaded = false;
+}
+
+bool cohort_state::read(const string &file, int32_t lpos, int32_t rpos)
+{
+	loaded = false;
+	ifstream fin(file.c_str(), ios::binary);
+	if(fin.fail()) return false;
+
+	int32_t magic = 0, version = 0;
+	read_binary(fin, magic);
+	read_binary(fin, version);
+	if(fin.fail() || magic != STATE_MAGIC || version != STATE_VERSION) return false;
+
+	// windows are cut anew when samples are added
+	int32_t l = -1, r = -1;
+	read_binary(fin, l);
+	read_binary(fin, r);
+	if(fin.fail()) return false;
+	if(l != lpos || r != rpos)
+	{
+		printf("cohort state %s is not used, as it covers [%d, %d) instead of [%d, %d)\n", file.c_str(), l, r, lpos, rpos);
+		return false;
+	}
+
+	read_binary_vector(fin, samples);
+
+	int64_t n = 0;
+	read_binary(fin, n);
+	instances.clear();
+	for(int64_t i = 0; i < n && fin.good(); i++)
+	{
+		string key;
+		read_binary_string(fin, key);
+		transcript_set ts(tmerge.chrm, tmerge.single_exon_overlap);
+		ts.read(fin);
+		instances.insert(instances.end(), make_pair(key, std::move(ts)));
+	}
+	tmerge.read(fin);
+
+	if(fin.fail()) return false;
+	loaded = true;
+	return true;
+}
+
+bool cohort_state::remap(const map<uint64_t, int> &ids)
+{
+	// the state is not used if a merged sample is removed;
+	// otherwise samples are renamed by their current positions
+	map<int, int> m;
+	for(int i = 0; i < samples.size(); i++)
+	{
+		auto it = ids.find(samples[i]);
+		if(it == ids.end()) loaded = false;
+		if(it == ids.end()) return false;
+		m[i] = it->second;
+	}
+
+	for(auto &x : instances) x.second.remap_samples(m);
+	tmerge.remap_samples(m);
+	return true;
+}
+
+bool cohort_state::contains(uint64_t id) const
+{
+	return find(samples.begin(), samples.end(), id) != samples.end();
+}
+
+int cohort_state::write(const string &file, int32_t lpos, int32_t rpos) const
+{
+	// written aside and renamed, so an interrupted run keeps the old state
+	string temp = file + ".tmp";
+	ofstream fout(temp.c_str(), ios::binary);
+	if(fout.fail())
+	{
+		printf("cannot open cohort state to write: %s\n", temp.c_str());
+		return 0;
+	}
+
+	int32_t magic = STATE_MAGIC, version = STATE_VERSION;
+	write_binary(fout, magic);
+	write_binary(fout, version);
+	write_binary(fout, lpos);
+	write_binary(fout, rpos);
+
+	write_binary_vector(fout, samples);
+
+	int64_t n = instances.size();
+	write_binary(fout, n);
+	for(auto &x : instances)
+	{
+		write_binary_string(fout, x.first);
+		x.second.write(fout);
+	}
+	tmerge.write(fout);
+	fout.close();
+
+	rename(temp.c_str(), file.c_str());
+	return 0;
+}
+
+string cohort_state::get_file(const string &dir, const string &chrm, int32_t lpos)
+{
+	string c = chrm;
+	replace(c.begin(), c.end(), '/', '_');
+	char file[10240];
+	sprintf(file, "%s/%s.%d.state", dir.c_str(), c.c_str(), lpos);
+	return string(file);
+}
+
+string cohort_state::get_instance_key(const vector<bundle*> &gv)
+{
+	// bundles are named by sample identity and extent, which
+	// do not depend on the order of samples in the list
+	vector<string> v;
+	for(int i = 0; i < gv.size(); i++)
+	{
+		const bundle &bd = *(gv[i]);
+		char buf[1024];
+		sprintf(buf, "%016llx:%c:%d-%d", (unsigned long long)(bd.sp.get_identity()), bd.strand, bd.lpos, bd.rpos);
+		v.push_back(buf);
+	}
+	sort(v.begin(), v.end());
+
+	// FNV-1a of the sorted names, with their number
+	uint64_t x = 14695981039346656037ULL;
+	for(int i = 0; i < v.size(); i++)
+	{
+		for(int k = 0; k < v[i].size(); k++)
+		{
+			x ^= (uint8_t)(v[i][k]);
+			x *= 1099511628211ULL;
+		}
+		x ^= (uint8_t)(',');
+		x *= 1099511628211ULL;
+	}
+
+	char key[1024];
+	sprintf(key, "%016llx.%lu", (unsigned long long)(x), v.size());
+	return string(key);
+}
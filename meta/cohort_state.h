@@ -0,0 +1,45 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#ifndef __COHORT_STATE_H__
+#define __COHORT_STATE_H__
+
+#include <set>
+#include <map>
+#include <vector>
+#include <string>
+
+#include "bundle.h"
+#include "transcript_set.h"
+
+using namespace std;
+
+// merged results of one window kept across runs: the samples merged,
+// the transcripts of each assembled instance (keyed by its bundles),
+// and the merged transcripts; a later run with new samples reuses the
+// instances they do not touch, and the whole window if none is touched;
+// files are named by window start, and a window with another end is not used
+class cohort_state
+{
+public:
+	cohort_state(const string &chrm, double single_exon_overlap);
+
+public:
+	bool loaded;									// whether read from a previous run
+	vector<uint64_t> samples;						// identities of merged samples, by sample id
+	map<string, transcript_set> instances;			// transcripts of instances
+	transcript_set tmerge;							// merged transcripts with sample coverage
+
+public:
+	bool read(const string &file, int32_t lpos, int32_t rpos);
+	bool remap(const map<uint64_t, int> &ids);
+	bool contains(uint64_t id) const;
+	int write(const string &file, int32_t lpos, int32_t rpos) const;
+	static string get_file(const string &dir, const string &chrm, int32_t lpos);
+	static string get_instance_key(const vector<bundle*> &gv);
+};
+
+#endif
@@ -404,8 +404,7 @@ int combined_graph::build_splice_graph(splice_graph &gr, const parameters &cfg)
 		double w = sbounds[i].second.first;
 		int c = sbounds[i].second.second;
 
-		assert(gr.lindex.find(p) != gr.lindex.end());
-		int k = gr.lindex[p];
+		int k = gr.lindex.find(p);
 		assert(k >= 1);
 		edge_descriptor e = gr.add_edge(0, k);
 		edge_info ei;
@@ -422,8 +421,8 @@ int combined_graph::build_splice_graph(splice_graph &gr, const parameters &cfg)
 		double w = tbounds[i].second.first;
 		int c = tbounds[i].second.second;
 
-		assert(gr.rindex.find(p) != gr.rindex.end());
-		int k = gr.rindex[p];
+		int k = gr.rindex.find(p);
+		assert(k >= 0);
 		assert(k < gr.num_vertices() - 1);
 		edge_descriptor e = gr.add_edge(k, gr.num_vertices() - 1);
 		edge_info ei;
@@ -445,10 +444,9 @@ int combined_graph::build_splice_graph(splice_graph &gr, const parameters &cfg)
 		int c = junctions[i].second.second;
 
 		// asserted?
-		if(gr.rindex.find(p.first) == gr.rindex.end()) continue;
-		if(gr.lindex.find(p.second) == gr.lindex.end()) continue;
-		int s = gr.rindex[p.first];
-		int t = gr.lindex[p.second];
+		int s = gr.rindex.find(p.first);
+		int t = gr.lindex.find(p.second);
+		if(s < 0 || t < 0) continue;
 		assert(s < t);
 		edge_descriptor e = gr.add_edge(s, t);
 		edge_info ei;
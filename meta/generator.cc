@@ -6,7 +6,9 @@ See LICENSE for licensing.
 
 #include <cstdio>
 #include <cassert>
+#include <climits>
 #include <sstream>
+#include <ctime>
 #include "boost/pending/disjoint_sets.hpp"
 #include <boost/asio/post.hpp>
 #include <boost/asio/thread_pool.hpp>
@@ -20,17 +22,47 @@ See LICENSE for licensing.
 #include "essential.h"
 #include "hyper_set.h"
 #include "assembler.h"
+#include "bam_reader.h"
+#include "bundle_store.h"
 
-generator::generator(sample_profile &s, vector<bundle> &v, transcript_set &t, const parameters &c, int tid)
-	: vcb(v), ts(t), cfg(c), sp(s), target_id(tid)
+#define READ_AHEAD_BATCH_SIZE 4096
+
+generator::generator(sample_profile &s, vector<bundle> &v, transcript_set &t, const parameters &c, int tid, int32_t l, int32_t r, boost::asio::thread_pool *p)
+	: vcb(v), ts(t), cfg(c), sp(s), target_id(tid), lpos(l), rpos(r), pool(p)
 {
 	index = 0;
-	sp.open_align_file();
+	queue = std::make_shared<bundle_queue>();
+	sfn = sam_open(sp.align_file.c_str(), "r");
+	hdr = sample_profile::read_handle_header(sfn);
+
+	// decompression is shared by all samples
+	if(sp.decode_pool != NULL) hts_set_thread_pool(sfn, sp.decode_pool);
+
+	// a kept store also serves as the spill file; it is written
+	// aside and renamed once complete, so readers never see a partial store
+	if(cfg.write_bundle_store != "" && target_id >= 0) spill_file = sp.get_store_file(cfg.write_bundle_store, target_id, lpos);
+	else if(cfg.spill_dir != "" && target_id >= 0) spill_file = sp.get_spill_file(cfg.spill_dir, target_id, lpos);
+
+	spill_temp = spill_file;
+	if(cfg.write_bundle_store != "" && spill_file != "") spill_temp = spill_file + ".tmp";
+
+	if(spill_file != "")
+	{
+		spill_out.open(spill_temp.c_str(), ios::binary);
+		if(spill_out.fail())
+		{
+			printf("cannot open file %s to spill bundles\n", spill_file.c_str());
+			exit(0);
+		}
+	}
 }
 
 generator::~generator()
 {
-	sp.close_align_file();
+	if(spill_out.is_open()) spill_out.close();
+	if(spill_temp != spill_file) remove(spill_temp.c_str());
+	if(hdr != NULL) bam_hdr_destroy(hdr);
+	if(sfn != NULL) sam_close(sfn);
 }
 
 int generator::resolve()
@@ -42,15 +74,30 @@ int generator::resolve()
 	bundle_base bb2;
 
 	int hid = 0;
-    bam1_t *b1t = bam_init1();
+	// query names are only needed for writing bridged alignments
+	bb1.keep_qnames = bb2.keep_qnames = (cfg.output_bridged_bam_dir != "");
 
-	hts_itr_t *iter = sp.iters[target_id];
+	// collapsed reads lose their names, so bridged bams need every read
+	bb1.weighted = bb2.weighted = (cfg.weighted_hits == true && bb1.keep_qnames == false);
+
+	// iterators are created for each unit on demand
+	hts_itr_t *iter = sp.get_iterator(target_id, lpos, rpos);
 	if(iter == NULL) return 0;
 
-	while(sam_itr_next(sp.sfn, iter, b1t) >= 0)
+	// records are decoded ahead on the shared pool while bundles are processed
+	bam_reader reader(sfn, iter, rpos, cfg.read_ahead_batches, READ_AHEAD_BATCH_SIZE, pool);
+	time_t start = time(NULL);
+
+	while(true)
 	{
+		bam1_t *b1t = reader.next();
+		if(b1t == NULL) break;
+
 		bam1_core_t &p = b1t->core;
 
+		if(p.pos < lpos) continue;													// belongs to the previous window
+		if(p.pos >= rpos) break;
+
 		if((p.flag & 0x4) >= 1) continue;											// read is not mapped
 		if((p.flag & 0x100) >= 1 && cfg.use_second_alignment == false) continue;	// secondary alignment
 		if(p.n_cigar > cfg.max_num_cigar) continue;									// ignore hits with more than max-num-cigar types
@@ -95,12 +142,29 @@ int generator::resolve()
 		*/
 	}
 
-    bam_destroy1(b1t);
+	reader.close();
+	if(cfg.verbose >= 2)
+	{
+		double t = difftime(time(NULL), start);
+		printf("ingest sample %d, tid %d, [%d, %d): %ld records in %.0lf seconds (%.0lf records/s, %d decode threads, %d read-ahead batches)\n",
+				sp.sample_id, target_id, lpos, rpos, reader.num_records, t, reader.num_records / (t > 1 ? t : 1), cfg.decode_threads, cfg.read_ahead_batches);
+	}
+
+	hts_itr_destroy(iter);
 
 	generate(bb1, index++);
 	generate(bb2, index++);
 	bb1.clear();
 	bb2.clear();
+	collect(0);
+
+	if(cfg.write_bundle_store != "")
+	{
+		bundle_store bs(sp, lpos, rpos);
+		bs.write_index(spill_out, cfg, vcb, ts);
+		spill_out.close();
+		rename(spill_temp.c_str(), spill_file.c_str());
+	}
 
 	return 0;
 }
@@ -110,18 +174,42 @@ int generator::generate(bundle_base &bb, int index)
 	if(bb.tid < 0) return 0;
 	char buf[1024];
 	strcpy(buf, sp.hdr->target_name[bb.tid]);
+	if(bb.weighted == true) bb.flush_weighted_hits();
 
+	// index follows the order bundles are closed, whichever thread bridges them
 	bundle bd(cfg, sp, std::move(bb));
 	bd.chrm = string(buf);
 	bd.gid = "gene." + tostring(sp.sample_id) + "." + tostring(index);
-	bd.build_fragments();
-	bd.bridge();
-	//bd.filter_multialigned_hits();
+	queue->push(std::move(bd));
 
-	// TODO, storing reads
-	// TODO, don't keep bridged reads
+	if(pool != NULL && cfg.bridge_queue_size >= 1)
+	{
+		std::shared_ptr<bundle_queue> q = queue;
+		boost::asio::post(*pool, [q]{ q->bridge(); });
+	}
 
-	vcb.push_back(std::move(bd));
+	collect(cfg.bridge_queue_size);
+	return 0;
+}
+
+int generator::collect(int limit)
+{
+	// the reader never blocks on the pool: it bridges waiting bundles itself
+	// and only waits when the earliest bundle is being bridged elsewhere
+	while(true)
+	{
+		int n = vcb.size();
+		queue->pop(vcb);
+
+		// keep only the splices in memory until assembling
+		for(int k = n; k < vcb.size(); k++)
+		{
+			if(spill_out.is_open()) vcb[k].spill(spill_out, spill_file);
+		}
+
+		if(queue->size() <= limit) break;
+		if(queue->bridge() == false) queue->wait();
+	}
 	return 0;
 }
 
@@ -136,17 +224,6 @@ bool generator::regional(splice_graph &gr, phase_set &ps, vector<pereads_cluster
 
 	if(all_regional == false && gr.num_edges() >= 1) return false;
 
-	if(cfg.output_bridged_bam_dir != "" && vc.size() >= 1)
-	{
-		sp.open_bridged_bam(cfg.output_bridged_bam_dir);
-		for(int k = 0; k < vc.size(); k++)
-		{
-			write_unbridged_pereads_cluster(sp.bridged_bam, vc[k]);
-			vc[k].clear();
-		}
-		sp.close_bridged_bam();
-	}
-
 	//gr.print(); printf("above graph is a regional graph\n\n");
 
 	return true;
@@ -158,17 +235,6 @@ bool generator::assemble_single(splice_graph &gr, phase_set &ps, vector<pereads_
 	bool b = build_single_exon_transcript(gr, t);
 	if(b == false) return false;
 
-	if(cfg.output_bridged_bam_dir != "" && vc.size() >= 1)
-	{
-		sp.open_bridged_bam(cfg.output_bridged_bam_dir);
-		for(int k = 0; k < vc.size(); k++)
-		{
-			write_unbridged_pereads_cluster(sp.bridged_bam, vc[k]);
-			vc[k].clear();
-		}
-		sp.close_bridged_bam();
-	}
-
 	//if(t.coverage < cfg.min_single_exon_transcript_coverage) return true;
 	if(t.length() < cfg.min_single_exon_transcript_length) return true;
 
@@ -206,10 +272,9 @@ int generator::partition(splice_graph &gr, phase_set &ps, vector<pereads_cluster
 		assert(v.size() % == 0);
 		assert(v.size() >= 2);
 		
-		assert(gr.lindex.find(v.front()) != gr.lindex.end());
-		assert(gr.rindex.find(v.back()) != gr.rindex.end());
-		int kl = gr.lindex[v.front()];
-		int kr = gr.rindex[v.back()];
+		int kl = gr.lindex.find(v.front());
+		int kr = gr.rindex.find(v.back());
+		assert(kl >= 0 && kr >= 0);
 		ds.union_set(kl, kr);
 	}
 	*/
@@ -223,10 +288,9 @@ int generator::partition(splice_graph &gr, phase_set &ps, vector<pereads_cluster
 		int x = gr.locate_vertex(p1);
 		int y = gr.locate_vertex(p2);
 		*/
-		assert(gr.rindex.find(ub[i].extend[1]) != gr.rindex.end());
-		assert(gr.lindex.find(ub[i].extend[2]) != gr.lindex.end());
-		int x = gr.rindex[ub[i].extend[1]];
-		int y = gr.lindex[ub[i].extend[2]];
+		int x = gr.rindex.find(ub[i].extend[1]);
+		int y = gr.lindex.find(ub[i].extend[2]);
+		assert(x >= 0 && y >= 0);
 		ds.union_set(x, y);
 	}
 
@@ -275,16 +339,26 @@ int generator::partition(splice_graph &gr, phase_set &ps, vector<pereads_cluster
 		build_child_splice_graph(gr, grv[k], vm[k]);
 	}
 
+	// phases are ordered by their first coordinate, locate them in one sweep
+	vector<int32_t> pf;
+	for(MVII::iterator it = ps.pmap.begin(); it != ps.pmap.end(); it++)
+	{
+		if(it->first.size() <= 1) continue;
+		pf.push_back(it->first.front());
+	}
+	vector<int> jf;
+	gr.lindex.find(pf, jf);
+
 	psv.resize(vv.size());
+	int pi = 0;
 	for(MVII::iterator it = ps.pmap.begin(); it != ps.pmap.end(); it++)
 	{
 		const vector<int> &v = it->first;
 		assert(v.size() % 2 == 0);
 		if(v.size() <= 1) continue;
 		
-		assert(gr.lindex.find(v.front()) != gr.lindex.end());
-		assert(gr.rindex.find(v.back()) != gr.rindex.end());
-		int j = gr.lindex[v.front()];
+		int j = jf[pi++];
+		assert(j >= 0);
 		int p = ds.find_set(j);
 		assert(m.find(p) != m.end());
 		int k = m[p];
@@ -295,7 +369,7 @@ int generator::partition(splice_graph &gr, phase_set &ps, vector<pereads_cluster
 	ubv.resize(vv.size());
 	for(int i = 0; i < ub.size(); i++)
 	{
-		int x = gr.rindex[ub[i].extend[1]];
+		int x = gr.rindex.find(ub[i].extend[1]);
 		int p = ds.find_set(x);
 		int k = m[p];
 		assert(k >= 0 && k < vv.size());
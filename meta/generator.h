@@ -10,6 +10,8 @@ See LICENSE for licensing.
 #include <fstream>
 #include <string>
 #include <mutex>
+#include <memory>
+#include <boost/asio/thread_pool.hpp>
 #include "bundle.h"
 #include "splice_graph.h"
 #include "phase_set.h"
@@ -18,19 +20,29 @@ See LICENSE for licensing.
 #include "sample_profile.h"
 #include "transcript_set.h"
 #include "parameters.h"
+#include "bundle_queue.h"
 
 using namespace std;
 
 class generator
 {
 public:
-	generator(sample_profile &sp, vector<bundle> &cbv, transcript_set &ts, const parameters &c, int target_id);
+	generator(sample_profile &sp, vector<bundle> &cbv, transcript_set &ts, const parameters &c, int target_id, int32_t lpos, int32_t rpos, boost::asio::thread_pool *pool);
 	~generator();
 
 private:
 	const parameters &cfg;
 	sample_profile &sp;
 	int target_id;
+	int32_t lpos;						// only reads starting in [lpos, rpos)
+	int32_t rpos;
+	samFile *sfn;						// own handle, samples are shared by concurrent units
+	bam_hdr_t *hdr;						// header of own handle, NULL for BAM (see read_handle_header)
+	string spill_file;					// spilled reads of bundles (or kept store)
+	string spill_temp;					// where spill_out writes; a kept store is renamed to spill_file
+	ofstream spill_out;
+	boost::asio::thread_pool *pool;		// shared pool bridging closed bundles, NULL to bridge in the reader
+	std::shared_ptr<bundle_queue> queue;	// closed bundles, outlives tasks posted to the pool
 
 	vector<bundle> &vcb;
 	transcript_set &ts;
@@ -41,6 +53,7 @@ public:
 
 private:
 	int generate(bundle_base &bb, int index);
+	int collect(int limit);
 	int partition(splice_graph &gr, phase_set &hs, vector<pereads_cluster> &ub, vector<splice_graph> &grv, vector<phase_set> &hsv, vector< vector<pereads_cluster> > &ubv);
 	bool regional(splice_graph &gr, phase_set &ps, vector<pereads_cluster> &vc);
 	bool assemble_single(splice_graph &gr, phase_set &ps, vector<pereads_cluster> &vc);
@@ -15,6 +15,7 @@ See LICENSE for licensing.
 #include "essential.h"
 #include "constants.h"
 #include "previewer.h"
+#include "bundle_store.h"
 
 #include <fstream>
 #include <sstream>
@@ -22,13 +23,37 @@ See LICENSE for licensing.
 #include <algorithm>
 #include <thread>
 #include <ctime>
+#include <climits>
 #include <boost/asio/post.hpp>
 #include <boost/asio/thread_pool.hpp>
 #include <boost/pending/disjoint_sets.hpp>
 
+genome_window::genome_window(const string &c, int32_t l, int32_t r)
+	: chrm(c), lpos(l), rpos(r)
+{
+}
+
+work_unit::work_unit(const genome_window &w, int k, double overlap)
+	: chrm(w.chrm), lpos(w.lpos), rpos(w.rpos), index(k), memory(0), tmerge(w.chrm, overlap), prior(w.chrm, overlap)
+{
+	reused = false;
+}
+
+work_batch::work_batch(int k)
+	: index(k)
+{
+}
+
 incubator::incubator(vector<parameters> &v)
-	: params(v), tmerge("", params[DEFAULT].min_single_exon_clustering_overlap)
+	: params(v), pool(v[DEFAULT].max_threads)
 {
+	num_running = 0;
+	generating = false;
+	resident = 0;
+	next_output = 0;
+	next_batch = 0;
+	decode_pool.pool = NULL;
+	decode_pool.qsize = 0;
 	if(params[DEFAULT].profile_only == true) return;
 	meta_gtf.open(params[DEFAULT].output_gtf_file.c_str());
 	if(meta_gtf.fail())
@@ -40,70 +65,187 @@ incubator::incubator(vector<parameters> &v)
 
 incubator::~incubator()
 {
+	pool.join();
 	if(params[DEFAULT].profile_only == true) return;
 	meta_gtf.close();
 }
 
 int incubator::resolve()
 {
+	if(params[DEFAULT].merge_gtf_list != "") return merge_gtf_files();
+
 	read_bam_list();
 	init_samples();
 
 	if(params[DEFAULT].profile_only == true) return 0;
 
 	build_sample_index();
+	build_windows();
+	build_batches();
 
-	time_t mytime;
-	for(auto &x: sindex)
+	if(params[DEFAULT].write_window_manifest != "")
 	{
-		string chrm = x.first;
-		tmerge.chrm = chrm;
+		write_window_manifest();
+		free_samples();
+		return 0;
+	}
+
+	// each batch is driven by a driver thread, which posts the actual
+	// work to the shared pool and waits for it; batches are admitted
+	// one at a time so that step 1 of a batch overlaps with steps 2-5
+	// of the previous batches as long as the memory budget allows
+	init_decode_pool();
+
+	// a fixed number of drivers take batches in order, so finished
+	// batches do not keep their threads until the whole run ends
+	int n = min((int)(batches.size()), max(1, params[DEFAULT].max_threads));
+	vector<thread> drivers;
+	for(int i = 0; i < n; i++)
+	{
+		drivers.push_back(thread([this]{
+				while(true)
+				{
+					int k = this->admit_batch();
+					if(k < 0) break;
+					work_batch wb(k);
+					const vector<int> &v = this->batches[k];
+					wb.units.reserve(v.size());
+					for(int i = 0; i < v.size(); i++) wb.units.emplace_back(this->windows[v[i]], v[i], this->params[DEFAULT].min_single_exon_clustering_overlap);
+					this->process(wb);
+				}
+			}));
+	}
 
-		// test
-		/*
-		size_t found = chrm.find("_");
-		if(found == string::npos) continue;
-		if(chrm != "chr11_KI270721v1_random") continue;
-		if(chrm == "chr1") continue;
-		if(chrm == "chr10") continue;
-		if(chrm == "chr11") continue;
-		if(chrm == "chr12") continue;
-		if(chrm == "chr13") continue;
-		if(chrm == "chr14") continue;
-		if(chrm == "chr11_KI270721v1_random") continue;
-		if(chrm == "chr14_GL000009v2_random") continue;
-		*/
+	for(int i = 0; i < drivers.size(); i++) drivers[i].join();
 
-		mytime = time(NULL);
-		printf("start processing chrm %s, %s", chrm.c_str(), ctime(&mytime));
+	free_samples();
+	free_decode_pool();
+	return 0;
+}
 
-		mytime = time(NULL);
-		printf("step 1: generate graphs for individual bam/sam files, %s", ctime(&mytime));
-		generate(chrm);
+int incubator::init_decode_pool()
+{
+	decode_pool.pool = NULL;
+	decode_pool.qsize = 0;
+	if(params[DEFAULT].decode_threads <= 0) return 0;
 
-		mytime = time(NULL);
-		printf("step 2: merge splice graphs, %s", ctime(&mytime));
-		merge();
+	decode_pool.pool = hts_tpool_init(params[DEFAULT].decode_threads);
+	if(decode_pool.pool == NULL) return 0;
 
-		mytime = time(NULL);
-		printf("step 3: assemble merged splice graphs, %s", ctime(&mytime));
-		assemble();
+	for(int i = 0; i < samples.size(); i++) samples[i].decode_pool = &decode_pool;
+	return 0;
+}
 
-		groups.clear();
+int incubator::free_decode_pool()
+{
+	for(int i = 0; i < samples.size(); i++) samples[i].decode_pool = NULL;
+	if(decode_pool.pool != NULL) hts_tpool_destroy(decode_pool.pool);
+	decode_pool.pool = NULL;
+	return 0;
+}
 
-		mytime = time(NULL);
-		printf("step 4: rearrange transcript sets, %s", ctime(&mytime));
-		rearrange();
+int incubator::admit_batch()
+{
+	// returns the index of the admitted batch, or -1 if none is left
+	int64_t budget = (int64_t)(params[DEFAULT].max_pipeline_memory) * 1024 * 1024;
+	unique_lock<mutex> lk(plock);
+	pcv.wait(lk, [this, budget]{ return next_batch >= batches.size() || num_running == 0 || (generating == false && resident < budget); });
+	if(next_batch >= batches.size()) return -1;
+	num_running++;
+	generating = true;
+	return next_batch++;
+}
 
-		mytime = time(NULL);
-		printf("step 5: postprocess and write assembled transcripts, %s", ctime(&mytime));
-		postprocess();
+int incubator::release_unit(work_unit &wu)
+{
+	lock_guard<mutex> lk(plock);
+	resident -= wu.memory;
+	wu.memory = 0;
+	pcv.notify_all();
+	return 0;
+}
 
-		mytime = time(NULL);
-		printf("finish processing chrm %s, %s\n", chrm.c_str(), ctime(&mytime));
+int incubator::remove_spill_files(const work_unit &wu)
+{
+	if(params[DEFAULT].spill_dir == "") return 0;
+	if(sindex.find(wu.chrm) == sindex.end()) return 0;
+	const vector<PI> &v = sindex[wu.chrm];
+	for(int i = 0; i < v.size(); i++)
+	{
+		string file = samples[v[i].first].get_spill_file(params[DEFAULT].spill_dir, v[i].second, wu.lpos);
+		remove(file.c_str());
 	}
+	return 0;
+}
 
-	free_samples();
+int incubator::process(work_batch &wb)
+{
+	if(wb.units.size() == 0) return 0;
+
+	time_t mytime;
+	char name[10240];
+	const work_unit &wf = wb.units.front();
+	if(wb.units.size() >= 2) sprintf(name, "%s ... %s (%lu chromosomes)", wf.chrm.c_str(), wb.units.back().chrm.c_str(), wb.units.size());
+	else if(wf.lpos <= 0 && wf.rpos >= INT32_MAX) sprintf(name, "%s", wf.chrm.c_str());
+	else sprintf(name, "%s:%d-%d", wf.chrm.c_str(), wf.lpos, wf.rpos);
+	const char *chrm = name;
+
+	mytime = time(NULL);
+	printf("start processing chrm %s, %s", chrm, ctime(&mytime));
+
+	mytime = time(NULL);
+	printf("step 1: generate graphs for individual bam/sam files (chrm %s), %s", chrm, ctime(&mytime));
+	generate(wb);
+
+	// allow the next batch to start generating
+	plock.lock();
+	for(int k = 0; k < wb.units.size(); k++)
+	{
+		work_unit &wu = wb.units[k];
+		for(int i = 0; i < wu.groups.size(); i++) wu.memory += wu.groups[i].estimate_memory();
+		resident += wu.memory;
+	}
+	generating = false;
+	pcv.notify_all();
+	plock.unlock();
+
+	mytime = time(NULL);
+	printf("step 2: merge splice graphs (chrm %s), %s", chrm, ctime(&mytime));
+	merge(wb);
+
+	mytime = time(NULL);
+	printf("step 3: assemble merged splice graphs (chrm %s), %s", chrm, ctime(&mytime));
+	assemble(wb);
+
+	for(int k = 0; k < wb.units.size(); k++)
+	{
+		work_unit &wu = wb.units[k];
+		wu.groups.clear();
+		release_unit(wu);
+		remove_spill_files(wu);
+	}
+
+	mytime = time(NULL);
+	printf("step 4: rearrange transcript sets (chrm %s), %s", chrm, ctime(&mytime));
+	rearrange(wb);
+	for(int k = 0; k < wb.units.size(); k++) save_cohort_state(wb.units[k]);
+
+	// write in the order of batches
+	unique_lock<mutex> lk(plock);
+	pcv.wait(lk, [this, &wb]{ return next_output == wb.index; });
+	lk.unlock();
+
+	mytime = time(NULL);
+	printf("step 5: postprocess and write assembled transcripts (chrm %s), %s", chrm, ctime(&mytime));
+	postprocess(wb);
+
+	mytime = time(NULL);
+	printf("finish processing chrm %s, %s\n", chrm, ctime(&mytime));
+
+	lk.lock();
+	next_output++;
+	num_running--;
+	pcv.notify_all();
 	return 0;
 }
 
@@ -142,40 +284,48 @@ int incubator::read_bam_list()
 
 int incubator::init_samples()
 {
-	boost::asio::thread_pool pool(params[DEFAULT].max_threads);
+	task_group tg;
+	tg.add(samples.size());
 	for(int i = 0; i < samples.size(); i++)
 	{
 		sample_profile &sp = samples[i];
-		boost::asio::post(pool, [this, &sp] 
+		boost::asio::post(pool, [this, &sp, &tg] 
 		{
 				const parameters &cfg = this->params[sp.data_type];
 
-				if(cfg.profile_only == true)
+				// cached profiles are keyed by file identity, and
+				// only missing or outdated ones are inferred again
+				sp.read_identity();
+				sp.read_index();
+
+				bool cached = false;
+				if(cfg.profile_dir != "") cached = sp.load_profile(cfg.profile_dir);
+
+				if(cached == true && cfg.verbose >= 1)
 				{
-					previewer pre(cfg, sp);
-					pre.infer_library_type();
-					if(sp.data_type == PAIRED_END) pre.infer_insertsize();
-					if(cfg.profile_dir != "") sp.save_profile(cfg.profile_dir);
-					return;
+					printf("load cached profile of %s\n", sp.align_file.c_str());
 				}
 
-				if(cfg.profile_dir != "")
+				if(cached == false)
 				{
-					sp.load_profile(cfg.profile_dir);
+					previewer pre(cfg, sp);
+					pre.infer_profile();
+					sp.count_target_reads();
+					if(cfg.profile_dir != "") sp.save_profile(cfg.profile_dir);
 				}
-				else
+
+				if(cfg.profile_only == true)
 				{
-					previewer pre(cfg, sp);
-					pre.infer_library_type();
-					if(sp.data_type == PAIRED_END) pre.infer_insertsize();
+					tg.finish();
+					return;
 				}
 
-				sp.read_index_iterators(); 
 				string bdir = cfg.output_bridged_bam_dir;
-				if(bdir != "") sp.init_bridged_bam(bdir);
+				if(bdir != "") sp.init_bridged_bam(bdir, cfg.bridged_bam_threads, cfg.sort_bridged_bam, (int64_t)(cfg.bridged_bam_buffer) * 1024 * 1024);
+				tg.finish();
 		});
 	}
-	pool.join();
+	tg.wait();
 	return 0;
 }
 
@@ -183,8 +333,9 @@ int incubator::free_samples()
 {
 	for(int i = 0; i < samples.size(); i++) 
 	{
-		samples[i].free_index_iterators();
-		//samples[i].free_align_headers();
+		samples[i].free_index();
+		samples[i].close_bridged_bam();
+		samples[i].free_align_headers();
 	}
 	return 0;
 }
@@ -216,144 +367,567 @@ int incubator::build_sample_index()
 		}
 	}
 
+	// headers were parsed (and cached) in parallel by init_samples
 	sindex.clear();
 	for(int i = 0; i < samples.size(); i++)
 	{
 		sample_profile &sp = samples[i];
-		sp.open_align_file();
+		assert(sp.hdr != NULL);
 		for(int k = 0; k < sp.hdr->n_targets; k++)
 		{
 			string chrm(sp.hdr->target_name[k]);
 			if(ss.size() >= 1 && ss.find(chrm) == ss.end()) continue;
+			sindex[chrm].push_back(PI(i, k));
+		}
+	}
+	return 0;
+}
 
-			if(sindex.find(chrm) == sindex.end())
-			{
-				vector<PI> v;
-				v.push_back(PI(i, k));
-				sindex.insert(make_pair(chrm, v));
-			}
-			else
-			{
-				sindex[chrm].push_back(PI(i, k));
-			}
+int incubator::build_windows()
+{
+	windows.clear();
+	if(params[DEFAULT].window_manifest != "") return read_window_manifest();
+
+	if(params[DEFAULT].window_size <= 0)
+	{
+		for(auto &x: sindex) windows.push_back(genome_window(x.first, 0, INT32_MAX));
+		return 0;
+	}
+
+	// scan read spans of all (sample, target) pairs in parallel; this decodes
+	// every read once more before assembly, so windows meant for several runs
+	// are best cut once with --write_window_manifest and read back with
+	// --window_manifest. Targets no longer than window_size are never cut
+	// and are not scanned
+	time_t start = time(NULL);
+	vector<PI> vp;
+	for(auto &x: sindex) vp.insert(vp.end(), x.second.begin(), x.second.end());
+
+	vector<vector<PI32>> vs(vp.size());
+	task_group tg;
+	for(int i = 0; i < vp.size(); i++)
+	{
+		sample_profile &sp = samples[vp[i].first];
+		int tid = vp[i].second;
+		if(sp.hdr->target_len[tid] <= params[DEFAULT].window_size) continue;
+		vector<PI32> &s = vs[i];
+		tg.add(1);
+		boost::asio::post(pool, [this, &sp, tid, &s, &tg]{ this->scan_spans(sp, tid, s); tg.finish(); });
+	}
+	tg.wait();
+
+	// pairs of each chromosome are contiguous in vp, in the order of sindex
+	int k = 0;
+	for(auto &x: sindex)
+	{
+		vector<PI32> spans;
+		for(int i = 0; i < x.second.size(); i++, k++)
+		{
+			spans.insert(spans.end(), vs[k].begin(), vs[k].end());
+			vector<PI32>().swap(vs[k]);
+		}
+		cut_windows(x.first, spans);
+	}
+	assert(k == vp.size());
+
+	if(params[DEFAULT].verbose >= 1) printf("cut %lu chromosomes into %lu windows in %.0lf seconds\n", sindex.size(), windows.size(), difftime(time(NULL), start));
+	return 0;
+}
+
+int incubator::cut_windows(const string &chrm, vector<PI32> &spans)
+{
+	// windows are cut only where all samples have a gap
+	// larger than min_bundle_gap, so bundles are the same
+	// as those generated from the whole chromosome
+	int32_t gap = params[DEFAULT].min_bundle_gap;
+	for(int i = 0; i < NUM_DATA_TYPES; i++) gap = max(gap, params[i].min_bundle_gap);
+
+	sort(spans.begin(), spans.end());
+
+	int32_t lpos = 0;
+	int32_t rpos = -1;
+	for(int i = 0; i < spans.size(); i++)
+	{
+		const PI32 &p = spans[i];
+		if(rpos >= 0 && p.first > rpos + gap && rpos - lpos >= params[DEFAULT].window_size)
+		{
+			windows.push_back(genome_window(chrm, lpos, p.first));
+			lpos = p.first;
 		}
-		sp.close_align_file();
+		if(p.second > rpos) rpos = p.second;
 	}
+	windows.push_back(genome_window(chrm, lpos, INT32_MAX));
 	return 0;
 }
 
-int incubator::generate(string chrm)
+int incubator::build_batches()
 {
-	if(sindex.find(chrm) == sindex.end()) return 0;
-	const vector<PI> &v = sindex[chrm];
+	// consecutive whole chromosomes are packed until their estimated
+	// reads reach max_batch_reads; windows of split chromosomes and
+	// chromosomes without index statistics are kept as single batches
+	batches.clear();
+	int64_t limit = params[DEFAULT].max_batch_reads;
+	int64_t total = 0;
+	for(int k = 0; k < windows.size(); k++)
+	{
+		const genome_window &w = windows[k];
+		int64_t n = -1;
+		if(limit > 0 && w.lpos <= 0 && w.rpos >= INT32_MAX) n = estimate_reads(w);
+
+		if(n < 0 || n >= limit)
+		{
+			batches.push_back(vector<int>(1, k));
+			total = limit;
+			continue;
+		}
+
+		if(batches.size() == 0 || total + n > limit)
+		{
+			batches.push_back(vector<int>());
+			total = 0;
+		}
+		batches.back().push_back(k);
+		total += n;
+	}
+
+	if(params[DEFAULT].verbose >= 1) printf("pack %lu windows into %lu batches\n", windows.size(), batches.size());
+	return 0;
+}
+
+int64_t incubator::estimate_reads(const genome_window &w)
+{
+	if(sindex.find(w.chrm) == sindex.end()) return 0;
+	const vector<PI> &v = sindex[w.chrm];
+
+	int64_t n = 0;
+	for(int i = 0; i < v.size(); i++)
+	{
+		const sample_profile &sp = samples[v[i].first];
+		int tid = v[i].second;
+		if(tid >= sp.target_reads.size() || sp.target_reads[tid] < 0) return -1;
+		n += sp.target_reads[tid];
+	}
+	return n;
+}
+
+int incubator::scan_spans(sample_profile &sp, int tid, vector<PI32> &spans)
+{
+	const parameters &cfg = params[sp.data_type];
+
+	samFile *sfn = sam_open(sp.align_file.c_str(), "r");
+	bam_hdr_t *hdr = sample_profile::read_handle_header(sfn);
+	hts_itr_t *iter = sp.get_iterator(tid, 0, INT32_MAX);
+	bam1_t *b1t = bam_init1();
+
+	// spans separated by gaps larger than min_bundle_gap,
+	// using the same filters and extents as the generator
+	int32_t lpos = -1;
+	int32_t rpos = -1;
+	while(iter != NULL && sam_itr_next(sfn, iter, b1t) >= 0)
+	{
+		bam1_core_t &p = b1t->core;
+
+		if((p.flag & 0x4) >= 1) continue;
+		if((p.flag & 0x100) >= 1 && cfg.use_second_alignment == false) continue;
+		if(p.n_cigar > cfg.max_num_cigar) continue;
+		if(p.qual < cfg.min_mapping_quality) continue;
+		if(p.n_cigar < 1) continue;
+
+		int32_t r = bam_endpos(b1t);
+		if(p.mpos > r && p.mpos <= r + 10000) r = p.mpos;
+
+		if(lpos >= 0 && p.pos > rpos + cfg.min_bundle_gap)
+		{
+			spans.push_back(PI32(lpos, rpos));
+			lpos = -1;
+		}
+
+		if(lpos < 0) lpos = p.pos;
+		if(r > rpos) rpos = r;
+	}
+	if(lpos >= 0) spans.push_back(PI32(lpos, rpos));
+
+	bam_destroy1(b1t);
+	if(iter != NULL) hts_itr_destroy(iter);
+	if(hdr != NULL) bam_hdr_destroy(hdr);
+	sam_close(sfn);
+	return 0;
+}
+
+int incubator::read_window_manifest()
+{
+	ifstream fin(params[DEFAULT].window_manifest.c_str());
+	if(fin.fail())
+	{
+		printf("cannot open window manifest file %s\n", params[DEFAULT].window_manifest.c_str());
+		exit(0);
+	}
+
+	char line[10240];
+	while(fin.getline(line, 10240, '\n'))
+	{
+		if(strlen(line) <= 0) continue;
+		stringstream sstr(line);
+		string chrm;
+		int32_t lpos, rpos;
+		sstr >> chrm >> lpos >> rpos;
+		if(sstr.fail()) continue;
+		if(sindex.find(chrm) == sindex.end()) continue;
+		windows.push_back(genome_window(chrm, lpos, rpos));
+	}
+	fin.close();
+	return 0;
+}
+
+int incubator::write_window_manifest()
+{
+	ofstream fout(params[DEFAULT].write_window_manifest.c_str());
+	if(fout.fail())
+	{
+		printf("cannot open window manifest file %s\n", params[DEFAULT].write_window_manifest.c_str());
+		exit(0);
+	}
+
+	for(int i = 0; i < windows.size(); i++)
+	{
+		fout << windows[i].chrm.c_str() << "\t" << windows[i].lpos << "\t" << windows[i].rpos << "\n";
+	}
+	fout.close();
+	return 0;
+}
+
+// appends a whole file; an empty file leaves fout usable
+static int append_file(const string &file, ofstream &fout)
+{
+	ifstream gin(file.c_str(), ios::binary);
+	if(gin.fail()) return -1;
+	if(gin.peek() != EOF) fout << gin.rdbuf();
+	gin.close();
+	return 0;
+}
+
+int incubator::merge_gtf_files()
+{
+	ifstream fin(params[DEFAULT].merge_gtf_list.c_str());
+	if(fin.fail())
+	{
+		printf("cannot open gtf list file %s\n", params[DEFAULT].merge_gtf_list.c_str());
+		exit(0);
+	}
+
+	// each line gives the gtf of a run and, optionally, the directory of its
+	// individual gtfs; windows are disjoint and ids carry the window start, so
+	// concatenating in the listed order gives the same result as one run
+	vector<string> dirs;
+	char line[10240];
+	while(fin.getline(line, 10240, '\n'))
+	{
+		if(strlen(line) <= 0) continue;
+		stringstream sstr(line);
+		string file, dir;
+		sstr >> file >> dir;
+		if(file == "") continue;
+		if(append_file(file, meta_gtf) != 0)
+		{
+			printf("cannot open gtf file %s\n", file.c_str());
+			exit(0);
+		}
+		if(dir != "") dirs.push_back(dir);
+	}
+	fin.close();
+
+	if(dirs.size() == 0 || params[DEFAULT].output_gtf_dir == "") return 0;
+
+	// samples are only counted, their files are not opened
+	if(params[DEFAULT].input_bam_list == "")
+	{
+		printf("merging individual gtf files needs the input bam list\n");
+		exit(0);
+	}
+	read_bam_list();
+
+	for(int i = 0; i < samples.size(); i++)
+	{
+		char file[10240];
+		sprintf(file, "%s/%d.gtf", params[DEFAULT].output_gtf_dir.c_str(), i);
+		ofstream fout(file, ios::binary);
+		if(fout.fail())
+		{
+			printf("cannot open individual gtf file %s\n", file);
+			exit(0);
+		}
+
+		// a run without transcripts of this sample has no file
+		for(int k = 0; k < dirs.size(); k++)
+		{
+			sprintf(file, "%s/%d.gtf", dirs[k].c_str(), i);
+			append_file(file, fout);
+		}
+		fout.close();
+	}
+	return 0;
+}
+
+int incubator::generate(work_batch &wb)
+{
+	// all (sample, tid) pairs of the batch run behind one barrier;
+	// with merged results of a previous run, new samples run first
+	task_group tg;
+	for(int k = 0; k < wb.units.size(); k++) load_cohort_state(wb.units[k]);
+	for(int k = 0; k < wb.units.size(); k++) generate(wb.units[k], tg, false);
+	tg.wait();
+
+	// merged samples are loaded only where new samples have
+	// bundles or transcripts; other units keep their results
+	task_group tx;
+	for(int k = 0; k < wb.units.size(); k++)
+	{
+		work_unit &wu = wb.units[k];
+		if(wu.prior.loaded == false) continue;
+
+		bool touched = false;
+		for(int i = 0; i < wu.slots.size(); i++) if(wu.slots[i].size() >= 1) touched = true;
+		for(int i = 0; i < wu.tslots.size(); i++) if(wu.tslots[i].mt.size() >= 1) touched = true;
+
+		if(touched == true) generate(wu, tx, true);
+		else wu.reused = true;
+	}
+	tx.wait();
+
+	for(int k = 0; k < wb.units.size(); k++)
+	{
+		work_unit &wu = wb.units[k];
+		for(int i = 0; i < wu.tslots.size(); i++)
+		{
+			if(wu.tslots[i].mt.size() == 0) continue;
+			wu.tsets.push_back(std::move(wu.tslots[i]));
+		}
+		vector<transcript_set>().swap(wu.tslots);
+
+		splice_groups(wu.slots, wu);
+		vector<vector<bundle>>().swap(wu.slots);
+		print_groups(wu);
+	}
+	return 0;
+}
+
+int incubator::generate(work_unit &wu, task_group &tg, bool merged)
+{
+	if(sindex.find(wu.chrm) == sindex.end()) return 0;
+	const vector<PI> &v = sindex[wu.chrm];
 	if(v.size() == 0) return 0;
 
-	int num_threads = params[DEFAULT].max_threads;
-	boost::asio::thread_pool pool(num_threads);			// thread pool
-	mutex mylock;										// lock for 
+	// each (sample, tid) fills its own slot without locking;
+	// slots are spliced into the groups after the barrier
+	if(wu.slots.size() != v.size()) wu.slots.resize(v.size());
+	if(wu.tslots.size() != v.size()) wu.tslots.assign(v.size(), transcript_set(wu.chrm, params[DEFAULT].min_single_exon_clustering_overlap));
 
 	for(int i = 0; i < v.size(); i++)
 	{
 		int sid = v[i].first;
 		int tid = v[i].second;
 		sample_profile &sp = samples[sid];
-		boost::asio::post(pool, [this, &mylock, &sp, chrm, tid]{ this->generate(sp, tid, chrm, mylock); });
+		if(is_merged(sp, wu) != merged) continue;
+
+		tg.add(1);
+		vector<bundle> &b = wu.slots[i];
+		transcript_set &t = wu.tslots[i];
+		boost::asio::post(pool, [this, &tg, &sp, &wu, tid, &b, &t]{ this->generate(sp, tid, wu, b, t); tg.finish(); });
 	}
+	return 0;
+}
 
-	pool.join();
-	print_groups();
+int incubator::splice_groups(vector<vector<bundle>> &vb, work_unit &wu)
+{
+	vector<bundle_group> &groups = wu.groups;
+
+	map<pair<string, char>, int> gindex;
+	for(int i = 0; i < groups.size(); i++) gindex.insert(make_pair(make_pair(groups[i].chrm, groups[i].strand), i));
 
+	vector<int> sizes(groups.size(), 0);
+	vector<vector<int>> vg(vb.size());
+	for(int i = 0; i < vb.size(); i++)
+	{
+		for(int k = 0; k < vb[i].size(); k++)
+		{
+			pair<string, char> z(vb[i][k].chrm, vb[i][k].strand);
+			auto it = gindex.find(z);
+			if(it == gindex.end())
+			{
+				bundle_group gp(z.first, z.second, params[DEFAULT]);
+				groups.push_back(std::move(gp));
+				sizes.push_back(0);
+				it = gindex.insert(make_pair(z, groups.size() - 1)).first;
+			}
+			vg[i].push_back(it->second);
+			sizes[it->second]++;
+		}
+	}
+
+	for(int i = 0; i < groups.size(); i++) groups[i].gset.reserve(groups[i].gset.size() + sizes[i]);
+
+	for(int i = 0; i < vb.size(); i++)
+	{
+		for(int k = 0; k < vb[i].size(); k++) groups[vg[i][k]].gset.push_back(std::move(vb[i][k]));
+		vector<bundle>().swap(vb[i]);
+	}
 	return 0;
 }
 
-int incubator::merge()
+int incubator::merge(work_batch &wb)
 {
-	for(int k = 0; k < groups.size(); k++) groups[k].resolve();
-	print_groups();
+	// groups are resolved concurrently, each as staged tasks on the pool
+	task_group tg;
+	for(int k = 0; k < wb.units.size(); k++)
+	{
+		work_unit &wu = wb.units[k];
+		tg.add(wu.groups.size());
+		for(int i = 0; i < wu.groups.size(); i++) wu.groups[i].resolve(pool, tg);
+	}
+	tg.wait();
+	for(int k = 0; k < wb.units.size(); k++) print_groups(wb.units[k]);
 	return 0;
 }
 
-int incubator::assemble()
+int incubator::assemble(work_batch &wb)
 {
-	boost::asio::thread_pool pool(params[DEFAULT].max_threads);
-	mutex mylock;
+	task_group tg;
+	vector<mutex> locks(wb.units.size());
+	for(int k = 0; k < wb.units.size(); k++) assemble(wb.units[k], tg, locks[k]);
+	tg.wait();
+	return 0;
+}
 
+int incubator::assemble(work_unit &wu, task_group &tg, mutex &mylock)
+{
+	// instances are numbered within each unit; ids also carry
+	// the window start, so they stay unique along the chromosome
+	// and across runs over disjoint windows (see merge_gtf_files)
 	int instance = 0;
-	for(int i = 0; i < groups.size(); i++)
+	for(int i = 0; i < wu.groups.size(); i++)
 	{
-		vector<bool> vb(groups[i].gset.size(), false);
-		for(int k = 0; k < groups[i].gvv.size(); k++)
+		vector<bool> vb(wu.groups[i].gset.size(), false);
+		for(int k = 0; k < wu.groups[i].gvv.size(); k++)
 		{
-			const vector<int> &v = groups[i].gvv[k];
+			const vector<int> &v = wu.groups[i].gvv[k];
 			if(v.size() == 0) continue;
 			vector<bundle*> gv;
 			for(int j = 0; j < v.size(); j++)
 			{
-				gv.push_back(&(groups[i].gset[v[j]]));
+				gv.push_back(&(wu.groups[i].gset[v[j]]));
 				assert(vb[v[j]] == false);
 				vb[v[j]] = true;
 			}
-			boost::asio::post(pool, [this, gv, instance, &mylock]{ this->assemble(gv, instance, mylock); });
+
+			// instances of merged samples only are kept from the previous run
+			if(wu.prior.loaded == true)
+			{
+				string key = cohort_state::get_instance_key(gv);
+				auto it = wu.prior.instances.find(key);
+				if(it != wu.prior.instances.end())
+				{
+					save_transcript_set(it->second, wu, mylock);
+					save_instance(key, it->second, wu, mylock);
+					instance++;
+					continue;
+				}
+			}
+
+			tg.add(1);
+			boost::asio::post(pool, [this, gv, instance, &wu, &mylock, &tg]{ this->assemble(gv, instance, wu, mylock); tg.finish(); });
 			instance++;
 		}
 	}
-	pool.join();
+	return 0;
+}
 
+int incubator::rearrange(work_batch &wb)
+{
+	task_group tg;
+	vector<mutex> locks(wb.units.size());
+	for(int k = 0; k < wb.units.size(); k++) rearrange(wb.units[k], tg, locks[k]);
+	tg.wait();
+	for(int k = 0; k < wb.units.size(); k++) wb.units[k].tsets.clear();
 	return 0;
 }
 
-int incubator::rearrange()
+int incubator::rearrange(work_unit &wu, task_group &tg, mutex &mylock)
 {
 	// filtering with count
 	/*
 	boost::asio::thread_pool pool(params[DEFAULT].max_threads);
-	for(int i = 0; i < tsets.size(); i++)
+	for(int i = 0; i < wu.tsets.size(); i++)
 	{
-		transcript_set &t = tsets[i];
-		assert(t.chrm == tmerge.chrm);
+		transcript_set &t = wu.tsets[i];
+		assert(t.chrm == wu.tmerge.chrm);
 		boost::asio::post(pool, [&t]{ t.filter(2); });
 	}
 	pool.join();
 	*/
 
+	// nothing new in this unit
+	if(wu.reused == true)
+	{
+		wu.tmerge = std::move(wu.prior.tmerge);
+		wu.instances = std::move(wu.prior.instances);
+		return 0;
+	}
+
 	// random sort
+	vector<transcript_set> &tsets = wu.tsets;
 	std::random_shuffle(tsets.begin(), tsets.end());
 
 	// merge
-	mutex mylock;
-	boost::asio::thread_pool pool2(params[DEFAULT].max_threads);
-
 	int t = params[DEFAULT].max_threads;
 	if(t <= 0) t = 1;
 	int n = ceil(1.0 * tsets.size() / t);
 
-	tmerge.mt.clear();
+	wu.tmerge.mt.clear();
+	tg.add(t);
 	for(int i = 0; i < t; i++)
 	{
 		int a = (i + 0) * n;
 		int b = (i + 1) * n;
 		if(b >= tsets.size()) b = tsets.size();
-		boost::asio::post(pool2, [this, &mylock, a, b]{ 
-				transcript_set ts(this->tmerge.chrm, params[DEFAULT].min_single_exon_clustering_overlap);
-				for(int k = a; k < b; k++) ts.add(this->tsets[k], TRANSCRIPT_COUNT_ADD_COVERAGE_ADD);
+		boost::asio::post(pool, [this, &wu, &mylock, &tg, a, b]{ 
+				transcript_set ts(wu.tmerge.chrm, params[DEFAULT].min_single_exon_clustering_overlap);
+				for(int k = a; k < b; k++) ts.add(wu.tsets[k], TRANSCRIPT_COUNT_ADD_COVERAGE_ADD);
 				mylock.lock();
-				this->tmerge.add(ts, TRANSCRIPT_COUNT_ADD_COVERAGE_ADD);
+				wu.tmerge.add(ts, TRANSCRIPT_COUNT_ADD_COVERAGE_ADD);
 				mylock.unlock();
+				tg.finish();
 			});
 	}
-	pool2.join();
+	return 0;
+}
+
+int incubator::postprocess(work_batch &wb)
+{
+	// individual transcripts of the batch are collected for each
+	// sample, so each individual gtf is opened once per batch
+	vector<string> gtfs(samples.size());
+	for(int k = 0; k < wb.units.size(); k++) postprocess(wb.units[k], gtfs);
+
+	if(params[DEFAULT].output_gtf_dir == "") return 0;
 
-	tsets.clear();
+	task_group tg;
+	tg.add(gtfs.size());
+	for(int i = 0; i < gtfs.size(); i++)
+	{
+		const string &s = gtfs[i];
+		boost::asio::post(pool, [this, i, &s, &tg]{ this->write_individual_gtf(i, s); tg.finish(); });
+	}
+	tg.wait();
 	return 0;
 }
 
-int incubator::postprocess()
+int incubator::postprocess(work_unit &wu, vector<string> &gtfs)
 {
 	stringstream ss;
 	vector<transcript> vt;
 	vector<int> ct;
 	vector<vector<pair<int, double>>> vv(samples.size());
-	for(auto &it : tmerge.mt)
+	for(auto &it : wu.tmerge.mt)
 	{
 		auto &v = it.second;
 		for(int k = 0; k < v.size(); k++)
@@ -385,54 +959,52 @@ int incubator::postprocess()
 
 	if(params[DEFAULT].output_gtf_dir != "")
 	{
-		boost::asio::thread_pool pool(params[DEFAULT].max_threads);
+		task_group tg;
+		tg.add(vv.size());
 		for(int i = 0; i < vv.size(); i++)
 		{
 			const vector<int> &c = ct;
 			const vector<transcript> &z = vt;
 			const vector<pair<int, double>> &v = vv[i];
-			boost::asio::post(pool, [this, i, &z, &c, &v]{ this->write_individual_gtf(i, z, c, v); });
+			string &g = gtfs[i];
+			boost::asio::post(pool, [this, i, &z, &c, &v, &g, &tg]{ this->build_individual_gtf(i, z, c, v, g); tg.finish(); });
 		}
-		pool.join();
+		tg.wait();
 	}
 
 	return 0;
 }
 
-int incubator::generate(sample_profile &sp, int tid, string chrm, mutex &mylock)
+int incubator::generate(sample_profile &sp, int tid, work_unit &wu, vector<bundle> &v, transcript_set &ts)
 {	
-	vector<bundle> v;
-	transcript_set ts(chrm, params[DEFAULT].min_single_exon_clustering_overlap);
-	generator gt(sp, v, ts, params[sp.data_type], tid);
-	gt.resolve();
-	save_transcript_set(ts, mylock);
+	const parameters &cfg = params[sp.data_type];
 
-	mylock.lock();
-	for(int k = 0; k < v.size(); k++)
+	// bundles kept by an earlier run replace reading the bam
+	if(cfg.read_bundle_store != "")
 	{
-		bool found = false;
-		for(int i = 0; i < groups.size(); i++)
+		bundle_store bs(sp, wu.lpos, wu.rpos);
+		string file = sp.get_store_file(cfg.read_bundle_store, tid, wu.lpos);
+		if(bs.load(file, cfg, v, ts) == true)
 		{
-			if(groups[i].chrm != v[k].chrm) continue;
-			if(groups[i].strand != v[k].strand) continue;
-			groups[i].gset.push_back(std::move(v[k]));
-			found = true;
-			break;
+			printf("load stored bundles of tid = %d of sample %s\n", tid, sp.align_file.c_str());
+			return 0;
 		}
+	}
 
-		if(found == false)
-		{
-			bundle_group gp(v[k].chrm, v[k].strand, params[DEFAULT]);
-			gp.gset.push_back(std::move(v[k]));
-			groups.push_back(std::move(gp));
-		}
+	// a merged sample touched by new samples is otherwise read again
+	if(is_merged(sp, wu) == true)
+	{
+		if(cfg.read_bundle_store == "") printf("merged sample %s is read again for tid = %d, as no bundle store is given\n", sp.align_file.c_str(), tid);
+		else printf("merged sample %s is read again for tid = %d, as its stored bundles are missing or outdated\n", sp.align_file.c_str(), tid);
 	}
-	mylock.unlock();
+
+	generator gt(sp, v, ts, cfg, tid, wu.lpos, wu.rpos, &pool);
+	gt.resolve();
 	printf("finish processing tid = %d of sample %s\n", tid, sp.align_file.c_str());
 	return 0;
 }
 
-int incubator::assemble(vector<bundle*> gv, int instance, mutex &mylock)
+int incubator::assemble(vector<bundle*> gv, int instance, work_unit &wu, mutex &mylock)
 {
 	if(gv.size() == 0) return 0;
 
@@ -441,16 +1013,19 @@ int incubator::assemble(vector<bundle*> gv, int instance, mutex &mylock)
 	//printf("assemble instance %d with %lu graphs\n", instance, gv.size());
 	//for(int k = 0; k < gv.size(); k++) gv[k]->print(k);
 
+	for(int i = 0; i < gv.size(); i++) gv[i]->reload();
+
 	assembler asmb(params[DEFAULT]);
-	asmb.resolve(gv, ts, instance);
+	asmb.resolve(gv, ts, wu.lpos, instance);
 
-	save_transcript_set(ts, mylock);
-	for(int i = 0; i > gv.size(); i++) gv[i]->clear();
+	save_transcript_set(ts, wu, mylock);
+	if(params[DEFAULT].cohort_dir != "") save_instance(cohort_state::get_instance_key(gv), ts, wu, mylock);
+	for(int i = 0; i < gv.size(); i++) gv[i]->clear();
 
 	return 0;
 }
 
-int incubator::write_individual_gtf(int id, const vector<transcript> &vt, const vector<int> &ct, const vector<pair<int, double>> &v)
+int incubator::build_individual_gtf(int id, const vector<transcript> &vt, const vector<int> &ct, const vector<pair<int, double>> &v, string &s)
 {
 	assert(id >= 0 && id < samples.size());
 
@@ -466,7 +1041,14 @@ int incubator::write_individual_gtf(int id, const vector<transcript> &vt, const
 		t.write(ss, cov2, ct[k]);
 	}
 
-	const string &s = ss.str();
+	s.append(ss.str());
+	return 0;
+}
+
+int incubator::write_individual_gtf(int id, const string &s)
+{
+	assert(id >= 0 && id < samples.size());
+	if(s.size() == 0) return 0;
 
 	sample_profile &sp = samples[id];
 	sp.gtf_lock.lock();
@@ -478,17 +1060,60 @@ int incubator::write_individual_gtf(int id, const vector<transcript> &vt, const
 	return 0;
 }
 
-int incubator::save_transcript_set(const transcript_set &ts, mutex &mylock)
+int incubator::save_transcript_set(const transcript_set &ts, work_unit &wu, mutex &mylock)
 {
 	if(ts.mt.size() == 0) return 0;
 	mylock.lock();
-	tsets.push_back(ts);
+	wu.tsets.push_back(ts);
 	mylock.unlock();
 	return 0;
 }
 
-int incubator::print_groups()
+int incubator::save_instance(const string &key, const transcript_set &ts, work_unit &wu, mutex &mylock)
+{
+	mylock.lock();
+	wu.instances.insert(make_pair(key, ts));
+	mylock.unlock();
+	return 0;
+}
+
+bool incubator::is_merged(const sample_profile &sp, const work_unit &wu) const
+{
+	if(wu.prior.loaded == false) return false;
+	return wu.prior.contains(sp.get_identity());
+}
+
+int incubator::load_cohort_state(work_unit &wu)
+{
+	if(params[DEFAULT].cohort_dir == "") return 0;
+
+	string file = cohort_state::get_file(params[DEFAULT].cohort_dir, wu.chrm, wu.lpos);
+	if(wu.prior.read(file, wu.lpos, wu.rpos) == false) return 0;
+
+	map<uint64_t, int> ids;
+	for(int i = 0; i < samples.size(); i++) ids.insert(make_pair(samples[i].get_identity(), i));
+	if(wu.prior.remap(ids) == false) printf("cohort state %s is not used, as merged samples are removed\n", file.c_str());
+	return 0;
+}
+
+int incubator::save_cohort_state(work_unit &wu)
+{
+	if(params[DEFAULT].cohort_dir == "") return 0;
+
+	cohort_state st(wu.chrm, params[DEFAULT].min_single_exon_clustering_overlap);
+	for(int i = 0; i < samples.size(); i++) st.samples.push_back(samples[i].get_identity());
+	st.instances = std::move(wu.instances);
+	st.tmerge = wu.tmerge;
+	st.write(cohort_state::get_file(params[DEFAULT].cohort_dir, wu.chrm, wu.lpos), wu.lpos, wu.rpos);
+
+	wu.instances.clear();
+	wu.prior.instances.clear();
+	return 0;
+}
+
+int incubator::print_groups(const work_unit &wu)
 {
+	const vector<bundle_group> &groups = wu.groups;
 	for(int k = 0; k < groups.size(); k++)
 	{
 		printf("group %d (chrm = %s, strand = %c) contains %lu graphs (%lu merged graphs)\n", k, groups[k].chrm.c_str(), groups[k].strand, groups[k].gset.size(), groups[k].gvv.size());
@@ -13,12 +13,61 @@ See LICENSE for licensing.
 #include "bundle_group.h"
 #include "parameters.h"
 #include "transcript_set.h"
+#include "task_group.h"
+#include "cohort_state.h"
 #include <mutex>
+#include <condition_variable>
+#include <boost/asio/thread_pool.hpp>
+#include <htslib/hts.h>
 
 typedef map< int32_t, set<int> > MISI;
 typedef pair< int32_t, set<int> > PISI;
 typedef pair<int, int> PI;
 
+class genome_window
+{
+public:
+	genome_window(const string &chrm, int32_t lpos, int32_t rpos);
+
+public:
+	string chrm;									// chromosome
+	int32_t lpos;									// reads starting in [lpos, rpos)
+	int32_t rpos;
+};
+
+class work_unit
+{
+public:
+	work_unit(const genome_window &w, int index, double single_exon_overlap);
+
+public:
+	string chrm;									// chromosome of this unit
+	int32_t lpos;									// window of this unit
+	int32_t rpos;
+	int index;										// rank in windows
+	int64_t memory;									// estimated resident memory of groups
+	vector<bundle_group> groups;					// graph groups
+	vector<transcript_set> tsets;					// transcript sets for instances
+	transcript_set tmerge;							// assembled transcripts for all samples
+	vector<vector<bundle>> slots;					// bundles of each (sample, tid) in step 1
+	vector<transcript_set> tslots;					// transcripts of each (sample, tid) in step 1
+	cohort_state prior;								// merged results of a previous run
+	map<string, transcript_set> instances;			// transcripts of instances in this run
+	bool reused;									// whether prior results are kept as a whole
+};
+
+// consecutive units that go through the five steps together,
+// so that small chromosomes share barriers and file writes
+class work_batch
+{
+public:
+	work_batch(int index);
+
+public:
+	int index;										// rank in batches, used to order output
+	vector<work_unit> units;						// units in the order of windows
+};
+
 class incubator
 {
 public:
@@ -29,31 +78,64 @@ public:
 	vector<parameters> &params;						// parameters 
 	vector<sample_profile> samples;					// samples
 	map<string, vector<PI>> sindex;					// sample index
-	vector<bundle_group> groups;						// graph groups
-	vector<transcript_set> tsets;					// transcript sets for instances
-	transcript_set tmerge;							// assembled transcripts for all samples
+	vector<genome_window> windows;					// units to process, ordered
+	vector<vector<int>> batches;					// windows packed into batches, ordered
 	ofstream meta_gtf;								// meta gtf
 
+private:
+	boost::asio::thread_pool pool;					// thread pool shared by all steps
+	htsThreadPool decode_pool;						// bgzf decompression shared by all samples
+	mutex plock;									// lock for pipeline states
+	condition_variable pcv;							// signal changes of pipeline states
+	int num_running;								// #batches in flight
+	bool generating;								// whether a batch is in step 1
+	int64_t resident;								// estimated memory of batches in flight
+	int next_output;								// index of the next batch to write
+	int next_batch;									// index of the next batch to admit
+
 public:
 	int resolve();
 
-	int generate(string chrm);
-	int merge();
-	int assemble();
-	int rearrange();
-	int postprocess();
+	int process(work_batch &wb);
+	int generate(work_batch &wb);
+	int merge(work_batch &wb);
+	int assemble(work_batch &wb);
+	int rearrange(work_batch &wb);
+	int postprocess(work_batch &wb);
 
 private:
 	int read_bam_list();
 	int init_samples();
 	int free_samples();
+	int init_decode_pool();
+	int free_decode_pool();
 	int build_sample_index();
-	int generate(sample_profile &sp, int tid, string chrm, mutex &mylock);
-	int assemble(vector<bundle*> gv, int instance, mutex &mylock);
-	int postprocess(const transcript_set &ts, ofstream &fout, mutex &mylock);
-	int save_transcript_set(const transcript_set &ts, mutex &mylock);
-	int write_individual_gtf(int id, const vector<transcript> &vt, const vector<int> &ct, const vector<pair<int, double>> &v);
-	int print_groups();
+	int build_windows();
+	int cut_windows(const string &chrm, vector<PI32> &spans);
+	int scan_spans(sample_profile &sp, int tid, vector<PI32> &spans);
+	int read_window_manifest();
+	int write_window_manifest();
+	int merge_gtf_files();
+	int admit_batch();
+	int release_unit(work_unit &wu);
+	int remove_spill_files(const work_unit &wu);
+	int build_batches();
+	int64_t estimate_reads(const genome_window &w);
+	int generate(work_unit &wu, task_group &tg, bool merged);
+	int generate(sample_profile &sp, int tid, work_unit &wu, vector<bundle> &v, transcript_set &ts);
+	int splice_groups(vector<vector<bundle>> &vb, work_unit &wu);
+	int assemble(work_unit &wu, task_group &tg, mutex &mylock);
+	int assemble(vector<bundle*> gv, int instance, work_unit &wu, mutex &mylock);
+	int rearrange(work_unit &wu, task_group &tg, mutex &mylock);
+	int postprocess(work_unit &wu, vector<string> &gtfs);
+	int save_transcript_set(const transcript_set &ts, work_unit &wu, mutex &mylock);
+	int save_instance(const string &key, const transcript_set &ts, work_unit &wu, mutex &mylock);
+	int load_cohort_state(work_unit &wu);
+	int save_cohort_state(work_unit &wu);
+	bool is_merged(const sample_profile &sp, const work_unit &wu) const;
+	int build_individual_gtf(int id, const vector<transcript> &vt, const vector<int> &ct, const vector<pair<int, double>> &v, string &s);
+	int write_individual_gtf(int id, const string &s);
+	int print_groups(const work_unit &wu);
 };
 
 #endif
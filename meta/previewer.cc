@@ -9,6 +9,8 @@ See LICENSE for licensing.
 #include <cstdio>
 #include <cassert>
 #include <sstream>
+#include <random>
+#include <algorithm>
 
 #include "bundle_base.h"
 #include "previewer.h"
@@ -17,84 +19,244 @@ See LICENSE for licensing.
 #include "graph_builder.h"
 #include "essential.h"
 
+#define PREVIEW_SEED 20200301
+#define MAX_PREVIEW_CLUSTERS 200000
+#define MAX_PENDING_BYTES ((int64_t)64 << 20)
+
 previewer::previewer(const parameters &c, sample_profile &s)
 	: cfg(c), sp(s)
 {
+	total = 0;
+	single = 0;
+	paired = 0;
+	num_xs = 0;
+	spliced = 0;
+	typed = false;
+	cnt = 0;
+	hid = 0;
+	pending_bytes = 0;
+	dropped = false;
+	limit = 0;
 }
 
 previewer::~previewer()
 {
+	for(int k = 0; k < pending.size(); k++)
+	{
+		for(int i = 0; i < pending[k].size(); i++) bam_destroy1(pending[k][i]);
+	}
 }
 
-int previewer::infer_library_type()
+int previewer::infer_profile()
 {
-	int total = 0;
-	int single = 0;
-	int paired = 0;
-	int num_xs = 0;
-	int spliced = 0;
+	sp.read_align_headers();
+	sp.read_index();
+
+	// without an index the file is read from its start
+	vector<PI32> regions;
+	if(sp.idx != NULL) sample_regions(regions);
+	else regions.push_back(PI32(-1, 0));
+
+	// reads are budgeted evenly over the regions
+	limit = cfg.max_preview_reads;
+	if(sp.idx != NULL && regions.size() >= 1) limit = max(1, (int)(cfg.max_preview_reads / regions.size()));
+
+	// reading from the start always passes the header
+	samFile *fp = sam_open(sp.align_file.c_str(), "r");
+	bam_hdr_t *h = NULL;
+	if(sp.idx == NULL) h = sam_hdr_read(fp);
+	else h = sample_profile::read_handle_header(fp);
+
+	bool insertsize = (sp.data_type == PAIRED_END);
+	vector<bam1_t*> vb;
+	for(int k = 0; k < regions.size(); k++)
+	{
+		int tid = regions[k].first;
+		int32_t lpos = regions[k].second;
 
-	int first = 0;
-	int second = 0;
-	vector<int> spn1;
-	vector<int> spn2;
+		hts_itr_t *iter = NULL;
+		if(tid >= 0) iter = sp.get_iterator(tid, lpos, lpos + cfg.preview_region_length);
+		if(tid >= 0 && iter == NULL) continue;
+		read_region(fp, iter, lpos, limit, vb);
+		if(iter != NULL) hts_itr_destroy(iter);
+
+		bool full = false;
+		for(int i = 0; i < vb.size() && typed == false && full == false; i++) full = add_library_read(vb[i]);
+
+		if(typed == false && full == true) infer_library_type();
+
+		if(insertsize == true && typed == false)
+		{
+			hold_region(regions[k], vb);
+		}
+		else if(insertsize == true)
+		{
+			add_insertsize_reads(vb);
+		}
+
+		if(typed == true && (insertsize == false || cnt >= MAX_PREVIEW_CLUSTERS)) break;
+	}
+
+	for(int i = 0; i < vb.size(); i++) bam_destroy1(vb[i]);
+	if(h != NULL) bam_hdr_destroy(h);
+	sam_close(fp);
+
+	if(typed == false) infer_library_type();
+	if(insertsize == true) infer_insertsize();
+	return 0;
+}
+
+int previewer::hold_region(const PI32 &r, vector<bam1_t*> &vb)
+{
+	// without strands (e.g., no XS tags) all regions may wait for the
+	// library type; beyond the bound only their positions are kept
+	pending_regions.push_back(r);
+	if(dropped == true)
+	{
+		for(int i = 0; i < vb.size(); i++) bam_destroy1(vb[i]);
+		vb.clear();
+		pending.push_back(vector<bam1_t*>());
+		return 0;
+	}
+
+	for(int i = 0; i < vb.size(); i++) pending_bytes += sizeof(bam1_t) + vb[i]->m_data;
+	pending.push_back(std::move(vb));
+	vb.clear();
+	if(pending_bytes <= MAX_PENDING_BYTES) return 0;
+
+	for(int k = 0; k < pending.size(); k++)
+	{
+		for(int i = 0; i < pending[k].size(); i++) bam_destroy1(pending[k][i]);
+		pending[k].clear();
+	}
+	dropped = true;
+	if(cfg.verbose >= 2) printf("preview of %s keeps %lu regions by position only\n", sp.align_file.c_str(), pending_regions.size());
+	return 0;
+}
+
+int previewer::reread_region(const PI32 &r, vector<bam1_t*> &vb)
+{
+	// a fresh handle, as the one of the pass may be closed already
+	samFile *fp = sam_open(sp.align_file.c_str(), "r");
+	bam_hdr_t *h = NULL;
+	if(r.first < 0) h = sam_hdr_read(fp);
+	else h = sample_profile::read_handle_header(fp);
+
+	hts_itr_t *iter = NULL;
+	if(r.first >= 0) iter = sp.get_iterator(r.first, r.second, r.second + cfg.preview_region_length);
+	if(r.first < 0 || iter != NULL) read_region(fp, iter, r.second, limit, vb);
+
+	if(iter != NULL) hts_itr_destroy(iter);
+	if(h != NULL) bam_hdr_destroy(h);
+	sam_close(fp);
+	return 0;
+}
+
+int previewer::sample_regions(vector<PI32> &regions)
+{
+	// targets are cut into slots of preview_region_length,
+	// from which a fixed number is drawn with a fixed seed
+	int32_t len = cfg.preview_region_length;
+	if(len <= 0) len = 1000000;
+
+	vector<PI32> slots;
+	for(int i = 0; i < sp.hdr->n_targets; i++)
+	{
+		int32_t n = sp.hdr->target_len[i];
+		for(int32_t p = 0; p < n; p += len) slots.push_back(PI32(i, p));
+	}
+
+	std::mt19937 rng(PREVIEW_SEED);
+	int n = min((int)(slots.size()), max(1, cfg.preview_regions));
+	for(int i = 0; i < n; i++)
+	{
+		std::uniform_int_distribution<int> dist(i, slots.size() - 1);
+		std::swap(slots[i], slots[dist(rng)]);
+	}
 
-	int hid = 0;
-	bam1_t *b1t = bam_init1();
-	sp.open_align_file();
+	regions.assign(slots.begin(), slots.begin() + n);
+	sort(regions.begin(), regions.end());
+	return 0;
+}
 
-    while(sam_read1(sp.sfn, sp.hdr, b1t) >= 0)
+int previewer::read_region(samFile *fp, hts_itr_t *iter, int32_t lpos, int limit, vector<bam1_t*> &vb)
+{
+	// records of vb are reused
+	int n = 0;
+	while(n < limit)
 	{
-		if(total >= cfg.max_preview_reads) break;
-		if(spn1.size() >= cfg.max_preview_spliced_reads && spn2.size() >= cfg.max_preview_spliced_reads) break;
+		if(n >= vb.size()) vb.push_back(bam_init1());
+		bam1_t *b1t = vb[n];
+
+		if(iter != NULL && sam_itr_next(fp, iter, b1t) < 0) break;
+		if(iter == NULL && sam_read1(fp, sp.hdr, b1t) < 0) break;
 
 		bam1_core_t &p = b1t->core;
 
+		if(p.pos < lpos) continue;													// belongs to the previous slot
 		if((p.flag & 0x4) >= 1) continue;											// read is not mapped
 		if((p.flag & 0x100) >= 1) continue;	// secondary alignment
 		if(p.n_cigar > cfg.max_num_cigar) continue;									// ignore hits with more than max-num-cigar types
 		if(p.qual < cfg.min_mapping_quality) continue;								// ignore hits with small quality
 		if(p.n_cigar < 1) continue;													// should never happen
 
-		total++;
+		n++;
+	}
 
-		hit ht(b1t, hid++);
-		ht.set_tags(b1t);
-		vector<int32_t> spos = ht.extract_splices(b1t);
+	for(int i = n; i < vb.size(); i++) bam_destroy1(vb[i]);
+	vb.resize(n);
+	return n;
+}
 
-		if(spos.size() <= 0) continue;
-		spliced++;
+bool previewer::add_library_read(bam1_t *b1t)
+{
+	// returns true when enough reads are collected
+	if(total >= cfg.max_preview_reads) return true;
+	if(spn1.size() >= cfg.max_preview_spliced_reads && spn2.size() >= cfg.max_preview_spliced_reads) return true;
 
-		if((ht.flag & 0x1) >= 1) paired ++;
-		if((ht.flag & 0x1) <= 0) single ++;
+	total++;
 
-		if(ht.xs == '.') continue;
-		num_xs++;
+	hit ht(b1t, hid++);
+	ht.set_tags(b1t);
+	vector<int32_t> spos = ht.extract_splices(b1t);
 
-		if(ht.xs == '+' && spn1.size() >= cfg.max_preview_spliced_reads) continue;
-		if(ht.xs == '-' && spn2.size() >= cfg.max_preview_spliced_reads) continue;
+	if(spos.size() <= 0) return false;
+	spliced++;
 
-		// predicted strand
-		char xs = '.';
+	if((ht.flag & 0x1) >= 1) paired ++;
+	if((ht.flag & 0x1) <= 0) single ++;
 
-		// for paired read
-		if((ht.flag & 0x1) >= 1 && (ht.flag & 0x10) <= 0 && (ht.flag & 0x20) >= 1 && (ht.flag & 0x40) >= 1 && (ht.flag & 0x80) <= 0) xs = '-';
-		if((ht.flag & 0x1) >= 1 && (ht.flag & 0x10) >= 1 && (ht.flag & 0x20) <= 0 && (ht.flag & 0x40) <= 0 && (ht.flag & 0x80) >= 1) xs = '-';
-		if((ht.flag & 0x1) >= 1 && (ht.flag & 0x10) >= 1 && (ht.flag & 0x20) <= 0 && (ht.flag & 0x40) >= 1 && (ht.flag & 0x80) <= 0) xs = '+';
-		if((ht.flag & 0x1) >= 1 && (ht.flag & 0x10) <= 0 && (ht.flag & 0x20) >= 1 && (ht.flag & 0x40) <= 0 && (ht.flag & 0x80) >= 1) xs = '+';
+	if(ht.xs == '.') return false;
+	num_xs++;
 
-		// for single read
-		if((ht.flag & 0x1) <= 0 && (ht.flag & 0x10) <= 0) xs = '-';
-		if((ht.flag & 0x1) <= 0 && (ht.flag & 0x10) >= 1) xs = '+';
+	if(ht.xs == '+' && spn1.size() >= cfg.max_preview_spliced_reads) return false;
+	if(ht.xs == '-' && spn2.size() >= cfg.max_preview_spliced_reads) return false;
 
-		if(xs == '+' && xs == ht.xs) spn1.push_back(1);
-		if(xs == '-' && xs == ht.xs) spn2.push_back(1);
-		if(xs == '+' && xs != ht.xs) spn1.push_back(2);
-		if(xs == '-' && xs != ht.xs) spn2.push_back(2);
-	}
+	// predicted strand
+	char xs = '.';
+
+	// for paired read
+	if((ht.flag & 0x1) >= 1 && (ht.flag & 0x10) <= 0 && (ht.flag & 0x20) >= 1 && (ht.flag & 0x40) >= 1 && (ht.flag & 0x80) <= 0) xs = '-';
+	if((ht.flag & 0x1) >= 1 && (ht.flag & 0x10) >= 1 && (ht.flag & 0x20) <= 0 && (ht.flag & 0x40) <= 0 && (ht.flag & 0x80) >= 1) xs = '-';
+	if((ht.flag & 0x1) >= 1 && (ht.flag & 0x10) >= 1 && (ht.flag & 0x20) <= 0 && (ht.flag & 0x40) >= 1 && (ht.flag & 0x80) <= 0) xs = '+';
+	if((ht.flag & 0x1) >= 1 && (ht.flag & 0x10) <= 0 && (ht.flag & 0x20) >= 1 && (ht.flag & 0x40) <= 0 && (ht.flag & 0x80) >= 1) xs = '+';
+
+	// for single read
+	if((ht.flag & 0x1) <= 0 && (ht.flag & 0x10) <= 0) xs = '-';
+	if((ht.flag & 0x1) <= 0 && (ht.flag & 0x10) >= 1) xs = '+';
+
+	if(xs == '+' && xs == ht.xs) spn1.push_back(1);
+	if(xs == '-' && xs == ht.xs) spn2.push_back(1);
+	if(xs == '+' && xs != ht.xs) spn1.push_back(2);
+	if(xs == '-' && xs != ht.xs) spn2.push_back(2);
+	return false;
+}
 
-    bam_destroy1(b1t);
-	sp.close_align_file();
+
+int previewer::infer_library_type()
+{
+	int first = 0;
+	int second = 0;
 
 	//int first1 = 0, second1 = 0;
 	//int first2 = 0, second2 = 0;
@@ -142,30 +304,31 @@ int previewer::infer_library_type()
 	printf("infer-library-type (%s): reads = %d, single = %d, paired = %d, spliced = %d, with-xs = %d, used = %d, first = %d, second = %d, inferred = %s, bam_with_xs = %d\n",
 			sp.align_file.c_str(), total, single, paired, spliced, num_xs, spn, first, second, vv[s1 + 1].c_str(), sp.bam_with_xs);
 
+	// regions read so far are bundled with the inferred strands
+	typed = true;
+	for(int k = 0; k < pending.size(); k++)
+	{
+		if(dropped == true && cnt < MAX_PREVIEW_CLUSTERS) reread_region(pending_regions[k], pending[k]);
+		if(cnt < MAX_PREVIEW_CLUSTERS) add_insertsize_reads(pending[k]);
+		for(int i = 0; i < pending[k].size(); i++) bam_destroy1(pending[k][i]);
+	}
+	pending.clear();
+	pending_regions.clear();
+	pending_bytes = 0;
+
 	return 0;
 }
 
-int previewer::infer_insertsize()
+int previewer::add_insertsize_reads(const vector<bam1_t*> &vb)
 {
 	bundle_base bb1;
 	bundle_base bb2;
 	bb1.strand = '+';
 	bb2.strand = '-';
-	map<int32_t, int> m;
-	int cnt = 0;
-	int hid = 0;
 
-	sp.open_align_file();
-	bam1_t *b1t = bam_init1();
-    while(sam_read1(sp.sfn, sp.hdr, b1t) >= 0)
+	for(int i = 0; i < vb.size(); i++)
 	{
-		bam1_core_t &p = b1t->core;
-
-		if((p.flag & 0x4) >= 1) continue;										// read is not mapped
-		if((p.flag & 0x100) >= 1) continue;	// secondary alignment
-		if(p.n_cigar > cfg.max_num_cigar) continue;									// ignore hits with more than max-num-cigar types
-		if(p.qual < cfg.min_mapping_quality) continue;								// ignore hits with small quality
-		if(p.n_cigar < 1) continue;												// should never happen
+		bam1_t *b1t = vb[i];
 
 		hit ht(b1t, hid++);
 		ht.set_tags(b1t);
@@ -185,7 +348,7 @@ int previewer::infer_insertsize()
 			bb2.strand = '-';
 		}
 
-		if(cnt >= 200000) break;
+		if(cnt >= MAX_PREVIEW_CLUSTERS) return 0;
 
 		// add hit
 		if(cfg.uniquely_mapped_only == true && ht.nh != 1) continue;
@@ -200,18 +363,23 @@ int previewer::infer_insertsize()
 		if(sp.library_type == UNSTRANDED && ht.xs == '-') bb2.add_hit_intervals(ht, b1t);
 	}
 
-    bam_destroy1(b1t);
-	sp.close_align_file();
+	// bundles end with the region
+	cnt += process(bb1, m);
+	cnt += process(bb2, m);
+	return 0;
+}
 
-	int total = 0;
+int previewer::infer_insertsize()
+{
+	int num = 0;
 	for(map<int, int>::iterator it = m.begin(); it != m.end(); it++)
 	{
-		total += it->second;
+		num += it->second;
 	}
 
-	if(total < 10000)
+	if(num < 10000)
 	{
-		printf("not enough paired-end reads to create the profile (%d collected)\n", total);
+		printf("not enough paired-end reads to create the profile (%d collected)\n", num);
 		return 0;
 	}
 
@@ -227,19 +395,27 @@ int previewer::infer_insertsize()
 	for(int k = 0; k < vv.size(); k++)
 	{
 		n += vv[k].second;
-		if(n >= 0.5 * total && sp.insertsize_median < 0) sp.insertsize_median = vv[k].first;
+		if(n >= 0.5 * num && sp.insertsize_median < 0) sp.insertsize_median = vv[k].first;
 		sp.insertsize_ave += vv[k].second * vv[k].first;
 		sx2 += vv[k].second * vv[k].first * vv[k].first;
-		if(sp.insertsize_low == -1 && n >= 0.005 * total) sp.insertsize_low = vv[k].first;
-		if(sp.insertsize_high == -1 && n >= 0.990 * total) sp.insertsize_high = vv[k].first;
-		if(n >= 0.998 * total) break;
+		if(sp.insertsize_low == -1 && n >= 0.005 * num) sp.insertsize_low = vv[k].first;
+		if(sp.insertsize_high == -1 && n >= 0.990 * num) sp.insertsize_high = vv[k].first;
+		if(n >= 0.998 * num) break;
 	}
 	
 	sp.insertsize_ave = sp.insertsize_ave * 1.0 / n;
 	sp.insertsize_std = sqrt((sx2 - n * sp.insertsize_ave * sp.insertsize_ave) * 1.0 / n);
 
+	// histogram of insert sizes up to the high end
+	sp.insertsize_profile.assign(max(sp.insertsize_high, 0) + 1, 0);
+	for(int k = 0; k < vv.size(); k++)
+	{
+		if(vv[k].first < 0 || vv[k].first > sp.insertsize_high) continue;
+		sp.insertsize_profile[vv[k].first] = vv[k].second * 1.0 / num;
+	}
+
 	printf("preview (%s) insertsize: sampled reads = %d, isize = %.2lf +/- %.2lf, median = %d, low = %d, high = %d\n", 
-				sp.align_file.c_str(), total, sp.insertsize_ave, sp.insertsize_std, sp.insertsize_median, sp.insertsize_low, sp.insertsize_high);
+				sp.align_file.c_str(), num, sp.insertsize_ave, sp.insertsize_std, sp.insertsize_median, sp.insertsize_low, sp.insertsize_high);
 
 	return 0;
 }
@@ -269,14 +445,21 @@ int previewer::process(bundle_base &bd, map<int32_t, int> &m)
 	
 	//printf("process bundle in previewer with %lu hits, %lu clusters\n", bd.hits.size(), vc.size());
 
+	vector<int32_t> px(vc.size());
+	vector<int32_t> py(vc.size());
+	for(int k = 0; k < vc.size(); k++) px[k] = vc[k].extend[1];
+	for(int k = 0; k < vc.size(); k++) py[k] = vc[k].extend[2];
+	vector<int> kx;
+	vector<int> ky;
+	gr.rindex.find(px, kx);
+	gr.lindex.find(py, ky);
+
 	int cnt = 0;
 	for(int k = 0; k < vc.size(); k++)
 	{
 		pereads_cluster &pc = vc[k];
-		int32_t p1 = pc.extend[1];
-		int32_t p2 = pc.extend[2];
-		int k1 = gr.locate_rbound(p1);
-		int k2 = gr.locate_lbound(p2);
+		int k1 = kx[k];
+		int k2 = ky[k];
 
 		if(k1 < 0 || k2 < 0 || k1 < k2) continue;
 
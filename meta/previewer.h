@@ -13,13 +13,19 @@ See LICENSE for licensing.
 #include "hit.h"
 #include "bundle_base.h"
 #include "sample_profile.h"
+#include "constants.h"
 
 #include <fstream>
 #include <string>
 #include <map>
+#include <vector>
 
 using namespace std;
 
+// infers the library type and the insert size of a sample in one
+// pass over randomly sampled regions of the index; regions read
+// before the library type is known are kept for the insert size,
+// up to MAX_PENDING_BYTES, beyond which they are read again
 class previewer
 {
 public:
@@ -30,10 +36,39 @@ private:
 	const parameters &cfg;
 	sample_profile &sp;
 
+	// for library type
+	int total;
+	int single;
+	int paired;
+	int num_xs;
+	int spliced;
+	vector<int> spn1;
+	vector<int> spn2;
+	bool typed;							// whether the library type is inferred
+
+	// for insert size
+	map<int32_t, int> m;
+	int cnt;
+	int hid;
+	vector<vector<bam1_t*>> pending;	// regions read before the library type is inferred
+	vector<PI32> pending_regions;		// where they are, to read them again once dropped
+	int64_t pending_bytes;				// size of the records kept in pending
+	bool dropped;						// whether records of pending are dropped to bound memory
+	int limit;							// records read from each region
+
 public:
+	int infer_profile();
+	int process(bundle_base &bb, map<int32_t, int> &m);
+
+private:
+	int sample_regions(vector<PI32> &regions);
+	int read_region(samFile *fp, hts_itr_t *iter, int32_t lpos, int limit, vector<bam1_t*> &vb);
+	int reread_region(const PI32 &r, vector<bam1_t*> &vb);
+	int hold_region(const PI32 &r, vector<bam1_t*> &vb);
+	bool add_library_read(bam1_t *b1t);
 	int infer_library_type();
+	int add_insertsize_reads(const vector<bam1_t*> &vb);
 	int infer_insertsize();
-	int process(bundle_base &bb, map<int32_t, int> &m);
 };
 
 #endif
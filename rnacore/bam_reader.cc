@@ -0,0 +1,169 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#include "bam_reader.h"
+
+#include <boost/asio/post.hpp>
+
+bam_batches::bam_batches(samFile *f, hts_itr_t *it, int32_t r, int b, int s)
+	: fp(f), iter(it), rpos(r), batches(b), batch_size(s)
+{
+	allocated = 0;
+	finished = false;
+	stopped = false;
+	active = false;
+	posted = false;
+}
+
+bam_batches::~bam_batches()
+{
+	for(int k = 0; k < full.size(); k++)
+	{
+		for(int i = 0; i < full[k].size(); i++) bam_destroy1(full[k][i]);
+	}
+	for(int k = 0; k < empty.size(); k++)
+	{
+		for(int i = 0; i < empty[k].size(); i++) bam_destroy1(empty[k][i]);
+	}
+}
+
+bool bam_batches::fill_next(unique_lock<mutex> &lk)
+{
+	// the iterator is used by one filler at a time, and not after stopped
+	if(stopped == true || finished == true || active == true) return false;
+
+	vector<bam1_t*> vb;
+	if(empty.size() >= 1)
+	{
+		vb = std::move(empty.back());
+		empty.pop_back();
+	}
+	else if(allocated < batches) allocated++;
+	else return false;
+
+	active = true;
+	lk.unlock();
+	int n = fill(vb);
+	lk.lock();
+	active = false;
+
+	if(n >= 1) full.push_back(std::move(vb));
+	if(n < batch_size) finished = true;
+	qcv.notify_all();
+	return true;
+}
+
+int bam_batches::fill(vector<bam1_t*> &vb)
+{
+	// records of a recycled batch are reused
+	int n = 0;
+	while(n < batch_size)
+	{
+		if(n >= vb.size()) vb.push_back(bam_init1());
+		if(sam_itr_next(fp, iter, vb[n]) < 0) break;
+		if(vb[n]->core.pos >= rpos) break;
+		n++;
+	}
+	for(int i = n; i < vb.size(); i++) bam_destroy1(vb[i]);
+	vb.resize(n);
+	return n;
+}
+
+// fills batches while free ones remain, then leaves the pool thread
+static void fill_batches(std::shared_ptr<bam_batches> bs)
+{
+	unique_lock<mutex> lk(bs->qlock);
+	bs->posted = false;
+	while(bs->fill_next(lk) == true);
+}
+
+bam_reader::bam_reader(samFile *f, hts_itr_t *it, int32_t r, int b, int s, boost::asio::thread_pool *p)
+	: fp(f), iter(it), rpos(r), pool(p)
+{
+	num_records = 0;
+	cursor = 0;
+	single = NULL;
+	finished = false;
+
+	if(s < 1) s = 1;
+	if(b <= 0 || pool == NULL)
+	{
+		single = bam_init1();
+		return;
+	}
+
+	bs = std::make_shared<bam_batches>(fp, iter, rpos, b, s);
+	lock_guard<mutex> lk(bs->qlock);
+	schedule();
+}
+
+bam_reader::~bam_reader()
+{
+	close();
+	for(int i = 0; i < current.size(); i++) bam_destroy1(current[i]);
+	if(single != NULL) bam_destroy1(single);
+}
+
+int bam_reader::close()
+{
+	// a task queued later finds the batches stopped and leaves
+	if(bs == NULL) return 0;
+	unique_lock<mutex> lk(bs->qlock);
+	bs->stopped = true;
+	bs->qcv.wait(lk, [this]{ return bs->active == false; });
+	return 0;
+}
+
+int bam_reader::schedule()
+{
+	if(bs->posted == true || bs->active == true) return 0;
+	if(bs->finished == true || bs->stopped == true) return 0;
+	if(bs->empty.size() == 0 && bs->allocated >= bs->batches) return 0;
+
+	bs->posted = true;
+	std::shared_ptr<bam_batches> p = bs;
+	boost::asio::post(*pool, [p]{ fill_batches(p); });
+	return 0;
+}
+
+bam1_t* bam_reader::next()
+{
+	if(single != NULL)
+	{
+		if(finished == true) return NULL;
+		if(sam_itr_next(fp, iter, single) < 0 || single->core.pos >= rpos)
+		{
+			finished = true;
+			return NULL;
+		}
+		num_records++;
+		return single;
+	}
+
+	if(cursor >= current.size())
+	{
+		unique_lock<mutex> lk(bs->qlock);
+		if(current.size() >= 1) bs->empty.push_back(std::move(current));
+		current.clear();
+		cursor = 0;
+
+		// nothing decoded yet: fill a batch here rather than wait for a pool thread
+		while(bs->full.size() == 0 && bs->finished == false)
+		{
+			if(bs->fill_next(lk) == true) continue;
+			bs->qcv.wait(lk);
+		}
+
+		if(bs->full.size() == 0) return NULL;
+		current = std::move(bs->full.front());
+		bs->full.pop_front();
+		schedule();
+	}
+
+	if(cursor >= current.size()) return NULL;
+	num_records++;
+	return current[cursor++];
+}
@@ -0,0 +1,83 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#ifndef __BAM_READER_H__
+#define __BAM_READER_H__
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <htslib/sam.h>
+#include <boost/asio/thread_pool.hpp>
+
+using namespace std;
+
+// decoded batches of one iterator, shared by the reader and the
+// tasks filling them, which may start after the reader is closed
+class bam_batches
+{
+public:
+	bam_batches(samFile *fp, hts_itr_t *iter, int32_t rpos, int batches, int batch_size);
+	~bam_batches();
+
+public:
+	samFile *fp;
+	hts_itr_t *iter;
+	int32_t rpos;						// stop at the first record starting at or after rpos
+	int batches;						// batches decoded ahead at most
+	int batch_size;
+	int allocated;						// batches created so far
+
+	deque<vector<bam1_t*>> full;		// decoded batches
+	vector<vector<bam1_t*>> empty;		// consumed batches
+	mutex qlock;
+	condition_variable qcv;
+	bool finished;						// iterator reaches the end
+	bool stopped;						// consumer leaves early
+	bool active;						// a batch is being filled
+	bool posted;						// a task is queued on the pool
+
+public:
+	bool fill_next(unique_lock<mutex> &lk);	// fill a free batch, false if none; qlock is released meanwhile
+	int fill(vector<bam1_t*> &vb);
+};
+
+// reads the alignments of an iterator ahead in tasks on the shared
+// pool; decoded records are handed over in batches, and consumed
+// batches are recycled; a task only runs while free batches remain,
+// and the reader fills a batch itself when it finds none decoded,
+// so read-ahead never waits for a pool thread; with batches = 0 or
+// without a pool records are read in the calling thread
+class bam_reader
+{
+public:
+	bam_reader(samFile *fp, hts_itr_t *iter, int32_t rpos, int batches, int batch_size, boost::asio::thread_pool *pool);
+	~bam_reader();
+
+public:
+	bam1_t *next();						// NULL at the end; valid until the next call
+	int close();						// stop reading, before the iterator is destroyed
+	int64_t num_records;				// records returned so far
+
+private:
+	samFile *fp;
+	hts_itr_t *iter;
+	int32_t rpos;
+	boost::asio::thread_pool *pool;
+	std::shared_ptr<bam_batches> bs;	// NULL when reading in the calling thread
+
+	vector<bam1_t*> current;			// batch being consumed
+	int cursor;
+	bam1_t *single;						// record for reading in the calling thread
+	bool finished;						// end reached in the calling thread
+
+private:
+	int schedule();						// post a filling task if useful, with qlock held
+};
+
+#endif
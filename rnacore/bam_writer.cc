@@ -0,0 +1,207 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#include "bam_writer.h"
+
+#include <cstdio>
+#include <cstdint>
+#include <cassert>
+#include <queue>
+#include <algorithm>
+#include <functional>
+
+#define MAX_QUEUED_BATCHES 64
+
+// by (tid, pos), unmapped records (tid < 0) last
+static bool bam_less(const bam1_t *x, const bam1_t *y)
+{
+	uint32_t tx = (uint32_t)(x->core.tid);
+	uint32_t ty = (uint32_t)(y->core.tid);
+	if(tx != ty) return tx < ty;
+	return x->core.pos < y->core.pos;
+}
+
+bam_writer::bam_writer(const string &f, const bam_hdr_t *h, int t, bool s, int64_t b)
+	: file(f), threads(t), sorted(s), buffer_limit(b)
+{
+	hdr = bam_hdr_dup(h);
+	finished = false;
+	buffer_size = 0;
+	fout = NULL;
+
+	// unsorted output is streamed into the final file
+	if(sorted == false) fout = open_output(file);
+
+	worker = thread([this]{ this->run(); });
+}
+
+bam_writer::~bam_writer()
+{
+	close();
+	if(hdr != NULL) bam_hdr_destroy(hdr);
+	hdr = NULL;
+}
+
+BGZF* bam_writer::open_output(const string &f)
+{
+	BGZF *fp = bgzf_open(f.c_str(), "w");
+	if(fp == NULL)
+	{
+		printf("cannot open bridged bam %s\n", f.c_str());
+		exit(0);
+	}
+	if(threads >= 2) bgzf_mt(fp, threads, 256);
+	bam_hdr_write(fp, hdr);
+	return fp;
+}
+
+int bam_writer::write(vector<bam1_t*> &vb)
+{
+	if(vb.size() == 0) return 0;
+	unique_lock<mutex> lk(qlock);
+	qcv.wait(lk, [this]{ return queue.size() < MAX_QUEUED_BATCHES; });
+	queue.push_back(std::move(vb));
+	vb.clear();
+	qcv.notify_all();
+	return 0;
+}
+
+int bam_writer::run()
+{
+	while(true)
+	{
+		vector<bam1_t*> vb;
+		{
+			unique_lock<mutex> lk(qlock);
+			qcv.wait(lk, [this]{ return queue.size() >= 1 || finished == true; });
+			if(queue.size() == 0) break;
+			vb = std::move(queue.front());
+			queue.pop_front();
+			qcv.notify_all();
+		}
+		consume(vb);
+	}
+	return 0;
+}
+
+int bam_writer::consume(vector<bam1_t*> &vb)
+{
+	for(int i = 0; i < vb.size(); i++)
+	{
+		if(sorted == false)
+		{
+			bam_write1(fout, vb[i]);
+			bam_destroy1(vb[i]);
+			continue;
+		}
+
+		buffer.push_back(vb[i]);
+		buffer_size += sizeof(bam1_t) + vb[i]->m_data;
+		if(buffer_size >= buffer_limit) write_chunk();
+	}
+	return 0;
+}
+
+int bam_writer::sort_buffer()
+{
+	stable_sort(buffer.begin(), buffer.end(), bam_less);
+	return 0;
+}
+
+int bam_writer::write_chunk()
+{
+	if(buffer.size() == 0) return 0;
+	sort_buffer();
+
+	char name[10240];
+	sprintf(name, "%s.tmp.%lu.bam", file.c_str(), chunks.size());
+	chunks.push_back(name);
+
+	BGZF *fp = open_output(name);
+	for(int i = 0; i < buffer.size(); i++)
+	{
+		bam_write1(fp, buffer[i]);
+		bam_destroy1(buffer[i]);
+	}
+	bgzf_close(fp);
+
+	buffer.clear();
+	buffer_size = 0;
+	return 0;
+}
+
+int bam_writer::merge_chunks()
+{
+	fout = open_output(file);
+
+	typedef pair<bam1_t*, int> PBI;
+	auto greater_bam = [](const PBI &x, const PBI &y){ return bam_less(y.first, x.first) || (bam_less(x.first, y.first) == false && x.second > y.second); };
+	priority_queue<PBI, vector<PBI>, decltype(greater_bam)> heap(greater_bam);
+
+	vector<BGZF*> fps(chunks.size(), NULL);
+	for(int k = 0; k < chunks.size(); k++)
+	{
+		fps[k] = bgzf_open(chunks[k].c_str(), "r");
+		bam_hdr_t *h = bam_hdr_read(fps[k]);
+		if(h != NULL) bam_hdr_destroy(h);
+		bam1_t *b = bam_init1();
+		if(bam_read1(fps[k], b) >= 0) heap.push(PBI(b, k));
+		else bam_destroy1(b);
+	}
+
+	while(heap.empty() == false)
+	{
+		PBI p = heap.top();
+		heap.pop();
+		bam_write1(fout, p.first);
+		if(bam_read1(fps[p.second], p.first) >= 0) heap.push(p);
+		else bam_destroy1(p.first);
+	}
+
+	for(int k = 0; k < chunks.size(); k++)
+	{
+		bgzf_close(fps[k]);
+		remove(chunks[k].c_str());
+	}
+	chunks.clear();
+	return 0;
+}
+
+int bam_writer::close()
+{
+	if(worker.joinable() == false) return 0;
+
+	qlock.lock();
+	finished = true;
+	qcv.notify_all();
+	qlock.unlock();
+	worker.join();
+
+	if(sorted == true && chunks.size() == 0)
+	{
+		// everything fits in memory
+		sort_buffer();
+		fout = open_output(file);
+		for(int i = 0; i < buffer.size(); i++)
+		{
+			bam_write1(fout, buffer[i]);
+			bam_destroy1(buffer[i]);
+		}
+		buffer.clear();
+		buffer_size = 0;
+	}
+	else if(sorted == true)
+	{
+		write_chunk();
+		merge_chunks();
+	}
+
+	if(fout != NULL) bgzf_close(fout);
+	fout = NULL;
+
+	if(sorted == true) sam_index_build(file.c_str(), 0);
+	return 0;
+}
@@ -0,0 +1,61 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#ifndef __BAM_WRITER_H__
+#define __BAM_WRITER_H__
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <htslib/sam.h>
+
+using namespace std;
+
+// writes the alignments of one sample from its own thread;
+// producers hand over batches through a bounded queue and
+// the file stays open (with multithreaded compression) until close;
+// sorted output is built from sorted chunks merged at close
+class bam_writer
+{
+public:
+	bam_writer(const string &file, const bam_hdr_t *hdr, int threads, bool sorted, int64_t buffer);
+	~bam_writer();
+
+public:
+	int write(vector<bam1_t*> &vb);		// takes over the records
+	int close();
+
+private:
+	string file;
+	bam_hdr_t *hdr;
+	int threads;
+	bool sorted;
+	int64_t buffer_limit;				// bytes of records kept for sorting
+
+	BGZF *fout;
+	deque<vector<bam1_t*>> queue;		// pending batches
+	mutex qlock;
+	condition_variable qcv;
+	bool finished;
+	thread worker;
+
+	vector<bam1_t*> buffer;				// records to be sorted
+	int64_t buffer_size;
+	vector<string> chunks;				// sorted chunks on disk
+
+private:
+	int run();
+	int consume(vector<bam1_t*> &vb);
+	int sort_buffer();
+	int write_chunk();
+	int merge_chunks();
+	BGZF *open_output(const string &f);
+};
+
+#endif
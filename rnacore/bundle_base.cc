@@ -21,17 +21,109 @@ bundle_base::bundle_base()
 	lpos = 1 << 30;
 	rpos = 0;
 	strand = '.';
+	keep_qnames = false;
+	weighted = false;
 }
 
 int bundle_base::add_hit_intervals(const hit &ht, bam1_t *b)
 {
+	if(weighted == true) return add_weighted_hit(ht, b);
+
 	add_hit(ht);
-	add_intervals(b);
+	if(keep_qnames == true)
+	{
+		assert(qnames.size() < INT32_MAX);
+		hits.back().qoff = qnames.size();
+		qnames.append(bam_get_qname(b), ht.get_qlen());
+	}
+	add_intervals(b->core.pos, bam_get_cigar(b), b->core.n_cigar, 1);
 	vector<int32_t> v = ht.extract_splices(b);
 	if(v.size() >= 1) hcst.add(v, hits.size() - 1, ht.xs);
 	return 0;
 }
 
+// hashes the fields compared by same_alignment, with the pair hash in qhash
+static uint64_t alignment_hash(const hit &ht, const uint32_t *cigar, int n_cigar)
+{
+	int32_t v[10] = {ht.pos, ht.rpos, ht.mpos, ht.isize, ht.flag, ht.nh, ht.hi, ht.nm, ht.xs, ht.ts};
+	uint64_t x = 14695981039346656037ULL;
+	for(int i = 0; i < 10; i++)
+	{
+		x ^= (uint32_t)v[i];
+		x *= 1099511628211ULL;
+	}
+	x ^= (uint64_t)ht.qhash;
+	x *= 1099511628211ULL;
+	for(int i = 0; i < n_cigar; i++)
+	{
+		x ^= cigar[i];
+		x *= 1099511628211ULL;
+	}
+	return x;
+}
+
+static bool same_alignment(const hit &x, const vector<uint32_t> &cx, const hit &y, const uint32_t *cy, int ny)
+{
+	if(x.pos != y.pos || x.rpos != y.rpos) return false;
+	if(x.mpos != y.mpos || x.isize != y.isize) return false;
+	if(x.flag != y.flag || x.nh != y.nh || x.hi != y.hi || x.nm != y.nm) return false;
+	if(x.xs != y.xs || x.ts != y.ts) return false;
+	if(x.qhash != y.qhash) return false;
+	if(cx.size() != ny) return false;
+	for(int i = 0; i < cx.size(); i++) if(cx[i] != cy[i]) return false;
+	return true;
+}
+
+int bundle_base::add_weighted_hit(const hit &x, bam1_t *b)
+{
+	assert(keep_qnames == false);
+
+	// alignments arrive sorted, so identical ones share the current position
+	if(pending.size() >= 1 && hits[pending.front().index].pos != x.pos) flush_weighted_hits();
+
+	// mates of collapsed reads find each other by template coordinates and cigars
+	hit ht = x;
+	ht.qhash = ht.get_pair_hash(b);
+
+	uint32_t *cigar = bam_get_cigar(b);
+	int n_cigar = b->core.n_cigar;
+	uint64_t k = alignment_hash(ht, cigar, n_cigar);
+	unordered_map<uint64_t, int>::iterator it = pindex.find(k);
+	if(it != pindex.end())
+	{
+		pending_hit &p = pending[it->second];
+		if(same_alignment(hits[p.index], p.cigar, ht, cigar, n_cigar) == true)
+		{
+			hits[p.index].weight++;
+			return 0;
+		}
+	}
+
+	add_hit(ht);
+
+	pending_hit p;
+	p.index = hits.size() - 1;
+	p.cigar.assign(cigar, cigar + n_cigar);
+	p.chain = ht.extract_splices(b);
+	if(it == pindex.end()) pindex.insert(make_pair(k, pending.size()));
+	pending.push_back(std::move(p));
+	return 0;
+}
+
+int bundle_base::flush_weighted_hits()
+{
+	for(int i = 0; i < pending.size(); i++)
+	{
+		const pending_hit &p = pending[i];
+		const hit &h = hits[p.index];
+		add_intervals(h.pos, p.cigar.data(), p.cigar.size(), h.weight);
+		if(p.chain.size() >= 1) hcst.add(p.chain, p.index, h.xs, h.weight);
+	}
+	pending.clear();
+	pindex.clear();
+	return 0;
+}
+
 int bundle_base::add_hit(const hit &ht)
 {
 	// store new hit
@@ -56,12 +148,9 @@ int bundle_base::add_hit(const hit &ht)
 	return 0;
 }
 
-int bundle_base::add_intervals(bam1_t *b)
+int bundle_base::add_intervals(int32_t p, const uint32_t *cigar, int n, int w)
 {
-	int32_t p = b->core.pos;
-	uint32_t *cigar = bam_get_cigar(b);
-
-    for(int k = 0; k < b->core.n_cigar; k++)
+	for(int k = 0; k < n; k++)
 	{
 		if(bam_cigar_type(bam_cigar_op(cigar[k]))&2)
 		{
@@ -71,18 +160,18 @@ int bundle_base::add_intervals(bam1_t *b)
 		if(bam_cigar_op(cigar[k]) == BAM_CMATCH)
 		{
 			int32_t s = p - bam_cigar_oplen(cigar[k]);
-			mmap += make_pair(ROI(s, p), 1);
+			mmap.add(s, p, w);
 		}
 
 		if(bam_cigar_op(cigar[k]) == BAM_CINS)
 		{
-			imap += make_pair(ROI(p - 1, p + 1), 1);
+			imap.add(p - 1, p + 1, w);
 		}
 
 		if(bam_cigar_op(cigar[k]) == BAM_CDEL)
 		{
 			int32_t s = p - bam_cigar_oplen(cigar[k]);
-			imap += make_pair(ROI(s, p), 1);
+			imap.add(s, p, w);
 		}
 	}
 	return 0;
@@ -90,8 +179,8 @@ int bundle_base::add_intervals(bam1_t *b)
 
 bool bundle_base::overlap(const hit &ht) const
 {
-	if(mmap.find(ROI(ht.pos, ht.pos + 1)) != mmap.end()) return true;
-	if(mmap.find(ROI(ht.rpos - 1, ht.rpos)) != mmap.end()) return true;
+	if(mmap.find(ht.pos) != mmap.end()) return true;
+	if(mmap.find(ht.rpos - 1) != mmap.end()) return true;
 	return false;
 }
 
@@ -103,6 +192,9 @@ int bundle_base::clear()
 	rpos = 0;
 	strand = '.';
 	hits.clear();
+	qnames.clear();
+	pending.clear();
+	pindex.clear();
 	hcst.clear();
 	fcst.clear();
 	mmap.clear();
@@ -110,6 +202,71 @@ int bundle_base::clear()
 	return 0;
 }
 
+// sweep the buffered intervals into the coverage maps
+int bundle_base::build_coverage()
+{
+	mmap.build();
+	imap.build();
+	return 0;
+}
+
+// keep meta information but free all read-level data
+int bundle_base::release()
+{
+	vector<hit>().swap(hits);
+	string().swap(qnames);
+	vector<AI3>().swap(frgs);
+	vector<int>().swap(fcounts);
+	hcst.clear();
+	fcst.clear();
+	mmap.release();
+	imap.release();
+	return 0;
+}
+
+string bundle_base::get_qname(int k) const
+{
+	const hit &h = hits[k];
+	if(h.qoff < 0) return "";
+	return qnames.substr(h.qoff, h.get_qlen());
+}
+
+int bundle_base::write(ostream &os) const
+{
+	int64_t n = hits.size();
+	write_binary(os, n);
+	for(int i = 0; i < hits.size(); i++) hits[i].write(os);
+	write_binary_string(os, qnames);
+	write_binary_vector(os, frgs);
+	write_binary_vector(os, fcounts);
+	hcst.write(os);
+	fcst.write(os);
+	mmap.write(os);
+	imap.write(os);
+	return 0;
+}
+
+int bundle_base::read(istream &is)
+{
+	int64_t n = 0;
+	read_binary(is, n);
+	hits.clear();
+	if(check_binary_count(is, n, 1) == false) return -1;
+	hits.resize(n);
+	for(int i = 0; i < n && is.good(); i++) hits[i].read(is);
+	read_binary_string(is, qnames);
+	read_binary_vector(is, frgs);
+	read_binary_vector(is, fcounts);
+	hcst.read(is);
+	fcst.read(is);
+	mmap.read(is);
+	imap.read(is);
+
+	// a short or corrupt record leaves the stream failed
+	if(is.fail()) return -1;
+	return 0;
+}
+
 int bundle_base::compute_strand(int libtype)
 {
 	if(libtype != UNSTRANDED) assert(strand != '.');
@@ -118,9 +275,9 @@ int bundle_base::compute_strand(int libtype)
 	int n0 = 0, np = 0, nq = 0;
 	for(int i = 0; i < hits.size(); i++)
 	{
-		if(hits[i].xs == '.') n0++;
-		if(hits[i].xs == '+') np++;
-		if(hits[i].xs == '-') nq++;
+		if(hits[i].xs == '.') n0 += hits[i].weight;
+		if(hits[i].xs == '+') np += hits[i].weight;
+		if(hits[i].xs == '-') nq += hits[i].weight;
 	}
 
 	if(np > nq) strand = '+';
@@ -171,58 +328,137 @@ int bundle_base::print(int index)
 	return 0;
 }
 
+// per-thread scratch for mate pairing, reused across bundles
+class mate_table
+{
+public:
+	vector<int> slots;		// open-addressing table, holds first hit of each key
+	vector<int> heads;		// first hit under each slot that may still be unpaired
+	vector<int> tails;		// last hit chained under each slot
+	vector<int> next;		// next hit with the same (qhash, pos, isize)
+	vector<int> rest;		// weight of each hit not yet paired
+	size_t mask;
+
+public:
+	int reset(const vector<hit> &hits);
+	int insert(const vector<hit> &hits, int i);
+	int locate(const vector<hit> &hits, int64_t qhash, int32_t pos, int32_t isize) const;
+};
+
+static inline size_t mate_key(int64_t qhash, int32_t pos, int32_t isize)
+{
+	uint64_t k = (uint64_t)qhash;
+	k ^= ((uint64_t)(uint32_t)pos << 32) | (uint64_t)(uint32_t)isize;
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	return (size_t)k;
+}
+
+int mate_table::reset(const vector<hit> &hits)
+{
+	size_t n = hits.size();
+	size_t m = 16;
+	while(m < n + n) m = m << 1;
+	mask = m - 1;
+	slots.assign(m, -1);
+	heads.resize(m);
+	tails.resize(m);
+	next.assign(n, -1);
+	rest.resize(n);
+	for(int i = 0; i < n; i++) rest[i] = hits[i].weight;
+	return 0;
+}
+
+int mate_table::insert(const vector<hit> &hits, int i)
+{
+	const hit &h = hits[i];
+	size_t k = mate_key(h.qhash, h.pos, h.isize) & mask;
+	while(slots[k] >= 0)
+	{
+		const hit &z = hits[slots[k]];
+		if(z.qhash == h.qhash && z.pos == h.pos && z.isize == h.isize) break;
+		k = (k + 1) & mask;
+	}
+
+	if(slots[k] < 0) slots[k] = heads[k] = i;
+	else next[tails[k]] = i;
+	tails[k] = i;
+	return 0;
+}
+
+int mate_table::locate(const vector<hit> &hits, int64_t qhash, int32_t pos, int32_t isize) const
+{
+	size_t k = mate_key(qhash, pos, isize) & mask;
+	while(slots[k] >= 0)
+	{
+		const hit &z = hits[slots[k]];
+		if(z.qhash == qhash && z.pos == pos && z.isize == isize) return k;
+		k = (k + 1) & mask;
+	}
+	return -1;
+}
+
+// one is the first and the other the last segment of the template
+static bool is_mate_pair(const hit &x, const hit &y)
+{
+	if((x.flag & 0x40) >= 1 && (x.flag & 0x80) <= 0 && (y.flag & 0x40) <= 0 && (y.flag & 0x80) >= 1) return true;
+	if((x.flag & 0x40) <= 0 && (x.flag & 0x80) >= 1 && (y.flag & 0x40) >= 1 && (y.flag & 0x80) <= 0) return true;
+	return false;
+}
+
 int bundle_base::build_fragments()
 {
 	frgs.clear();
+	fcounts.clear();
 	if(hits.size() == 0) return 0;
 
-	int max_index = hits.size() + 1;
-	if(max_index > 1000000) max_index = 1000000;
-
-	vector<bool> paired(hits.size(), false);
-	vector< vector<int> > vv;
-	vv.resize(max_index);
+	static thread_local mate_table mt;
+	mt.reset(hits);
 
-	// first build index
+	// index hits by (qhash, pos, isize); chains keep ascending order
 	for(int i = 0; i < hits.size(); i++)
 	{
-		const hit &h = hits[i];
-		if(h.hid < 0) continue;
-
-		// do not use hi; as long as qname, pos and isize are identical
-		int k = (h.get_qhash() % max_index + h.pos % max_index + (0 - h.isize) % max_index) % max_index;
-		vv[k].push_back(i);
+		if(hits[i].hid < 0) continue;
+		mt.insert(hits, i);
 	}
 
+	// pair each hit with the first unpaired hits at (qhash, mpos, -isize)
+	// that are the other segment of the template (0x40 against 0x80);
+	// a weighted hit may take several mates, each fragment carries the shared weight
 	for(int i = 0; i < hits.size(); i++)
 	{
 		const hit &h = hits[i];
 		if(h.hid < 0) continue;
-		if(paired[i] == true) continue;
+		if(mt.rest[i] <= 0) continue;
+
+		int k = mt.locate(hits, h.qhash, h.mpos, 0 - h.isize);
+		if(k < 0) continue;
 
-		int k = (h.get_qhash() % max_index + h.mpos % max_index + h.isize % max_index) % max_index;
-		int x = -1;
-		for(int j = 0; j < vv[k].size(); j++)
+		while(mt.rest[i] >= 1)
 		{
-			int u = vv[k][j];
-			const hit &z = hits[u];
-			if(u == i) continue;
-			//if(z.hi != h.hi) continue;
-			if(paired[u] == true) continue;
-			if(z.pos != h.mpos) continue;
-			if(z.isize + h.isize != 0) continue;
-			//if(z.qhash != h.qhash) continue;
-			if(z.qname != h.qname) continue;
-			x = u;
-			break;
+			// drop paired hits from the head so later lookups stay short
+			while(mt.heads[k] >= 0 && mt.rest[mt.heads[k]] <= 0) mt.heads[k] = mt.next[mt.heads[k]];
+
+			int x = -1;
+			for(int u = mt.heads[k]; u >= 0; u = mt.next[u])
+			{
+				if(u == i) continue;
+				if(mt.rest[u] <= 0) continue;
+				if(is_mate_pair(h, hits[u]) == false) continue;
+				x = u;
+				break;
+			}
+
+			if(x == -1) break;
+
+			assert(i != x);
+			int w = min(mt.rest[i], mt.rest[x]);
+			frgs.push_back(AI3({i, x, 0}));
+			fcounts.push_back(w);
+			mt.rest[i] -= w;
+			mt.rest[x] -= w;
 		}
-
-		if(x == -1) continue;
-
-		assert(i != x);
-		frgs.push_back(AI3({i, x, 0}));
-		paired[i] = true;
-		paired[x] = true;
 	}
 
 	//printf("total hits = %lu, total fragments = %lu\n", hits.size(), frgs.size());
@@ -231,26 +467,40 @@ int bundle_base::build_fragments()
 
 int bundle_base::build_phase_set(phase_set &ps, splice_graph &gr)
 {
-	vector<int> fb(hits.size(), -1);
+	// weight of each hit not covered by a paired or bridged fragment
+	vector<int> rest(hits.size());
+	for(int i = 0; i < hits.size(); i++) rest[i] = hits[i].weight;
+
+	// locate the first and last vertex of every hit in two sweeps
+	vector<int32_t> px(hits.size());
+	vector<int32_t> py(hits.size());
+	for(int i = 0; i < hits.size(); i++) px[i] = hits[i].pos;
+	for(int i = 0; i < hits.size(); i++) py[i] = hits[i].rpos - 1;
+	vector<int> ux;
+	vector<int> uy;
+	gr.locate_vertices(px, ux);
+	gr.locate_vertices(py, uy);
+
 	for(int i = 0; i < frgs.size(); i++)
 	{
 		if(frgs[i][2] <= -1) continue;
 
 		int h1 = frgs[i][0];	
 		int h2 = frgs[i][1];
+		int w = fcounts[i];
 
 		assert(hits[h1].hid >= 0);
 		assert(hits[h2].hid >= 0);
 
 		if(frgs[i][2] == 0)
 		{
-			fb[h1] = 0;			// paired, to be bridged
-			fb[h2] = 0;			// paired, to be bridged
+			rest[h1] -= w;		// paired, to be bridged
+			rest[h2] -= w;		// paired, to be bridged
 			continue;
 		}
 
-		int u1 = gr.locate_vertex(hits[h1].pos);
-		int u2 = gr.locate_vertex(hits[h2].rpos - 1);
+		int u1 = ux[h1];
+		int u2 = uy[h2];
 
 		if(u1 < 0 || u2 < 0) continue;
 		int32_t p1 = gr.get_vertex_info(u1).lpos;
@@ -281,19 +531,19 @@ int bundle_base::build_phase_set(phase_set &ps, splice_graph &gr)
 		bool b = check_increasing_sequence(xy);
 		if(b == false) continue;
 
-		fb[h1] = 1;			// bridged
-		fb[h2] = 1;			// bridged
+		rest[h1] -= w;		// bridged
+		rest[h2] -= w;		// bridged
 
-		ps.add(xy, 1);
+		ps.add(xy, w);
 	}
 
 	for(int i = 0; i < hits.size(); i++)
 	{
-		if(fb[i] >= 0) continue;
+		if(rest[i] <= 0) continue;
 		if(hits[i].hid < 0) continue;
 
-		int u1 = gr.locate_vertex(hits[i].pos);
-		int u2 = gr.locate_vertex(hits[i].rpos - 1);
+		int u1 = ux[i];
+		int u2 = uy[i];
 
 		if(u1 < 0 || u2 < 0) continue;
 		int32_t p1 = gr.get_vertex_info(u1).lpos;
@@ -306,7 +556,7 @@ int bundle_base::build_phase_set(phase_set &ps, splice_graph &gr)
 		bool b = check_increasing_sequence(xy);
 		if(b == false) continue;
 
-		ps.add(xy, 1);
+		ps.add(xy, rest[i]);
 	}
 	return 0;
 }
@@ -361,16 +611,17 @@ int bundle_base::update_bridges(const vector<int> &frlist, const vector<int32_t>
 		{
 			assert(chain.size() >= 2);
 			frgs[k][2] = 2;
-			if(h1.xs == h2.xs) fcst.add(chain, k, h1.xs);
-			else fcst.add(chain, k, '.');
+			if(h1.xs == h2.xs) fcst.add(chain, k, h1.xs, fcounts[k]);
+			else fcst.add(chain, k, '.', fcounts[k]);
 		}
 
+		int w = fcounts[k];
 		for(int k = 0; k < v1.size() / 2; k++)
 		{
 			int32_t p1 = v1[k * 2 + 0];
 			int32_t p2 = v1[k * 2 + 1];
 			if(p1 >= p2) continue;
-			mmap += make_pair(ROI(p1, p2), 1);
+			mmap.add(p1, p2, w);
 		}
 	}
 	return cnt;
@@ -398,7 +649,7 @@ int bundle_base::eliminate_bridge(int k)
 		int32_t p1 = v1[i * 2 + 0];
 		int32_t p2 = v1[i * 2 + 1];
 		if(p1 >= p2) continue;
-		mmap += make_pair(ROI(p1, p2), -1);
+		mmap.add(p1, p2, 0 - fcounts[k]);
 	}
 
 	frgs[k][2] = -1;
@@ -426,7 +677,7 @@ int bundle_base::eliminate_hit(int k)
 		int32_t p1 = v1[i * 2 + 0];
 		int32_t p2 = v1[i * 2 + 1];
 		if(p1 >= p2) continue;
-		mmap += make_pair(ROI(p1, p2), -1);
+		mmap.add(p1, p2, 0 - h1.weight);
 	}
 
 	h1.hid = -1;
@@ -437,15 +688,15 @@ int bundle_base::eliminate_hit(int k)
 
 int bundle_base::filter_secondary_hits()
 {
-	set<string> primary;
+	set<int64_t> primary;
 	for(int i = 0; i < frgs.size(); i++)
 	{
 		int h1 = frgs[i][0];
 		int h2 = frgs[i][1];
-		assert(hits[h1].qname == hits[h2].qname);
+		assert(hits[h1].qhash == hits[h2].qhash);
 		if((hits[h1].flag & 0x100) <= 0 && (hits[h2].flag & 0x100) <= 0)
 		{
-			primary.insert(hits[h1].qname);
+			primary.insert(hits[h1].qhash);
 		}
 	}
 
@@ -457,7 +708,7 @@ int bundle_base::filter_secondary_hits()
 		int h2 = frgs[i][1];
 		if((hits[h1].flag & 0x100) <= 0) continue;
 		if((hits[h2].flag & 0x100) <= 0) continue;
-		if(primary.find(hits[h1].qname) == primary.end()) continue;
+		if(primary.find(hits[h1].qhash) == primary.end()) continue;
 		cnt++;
 		redundant[h1] = true;
 		redundant[h2] = true;
@@ -472,7 +723,7 @@ int bundle_base::filter_secondary_hits()
 		if(redundant[i] == true) continue;
 		v.push_back(hits[i]);
 		vector<int32_t> chain = hcst.get(i).first;
-		if(chain.size() >= 1) s.add(chain, v.size() - 1, hits[i].xs);
+		if(chain.size() >= 1) s.add(chain, v.size() - 1, hits[i].xs, hits[i].weight);
 	}
 	hits = v;
 	hcst = s;
@@ -482,16 +733,16 @@ int bundle_base::filter_secondary_hits()
 
 int bundle_base::filter_multialigned_hits()
 {
-	set<string> bridged;
-	set<string> primary;
+	set<int64_t> bridged;
+	set<int64_t> primary;
 	for(int i = 0; i < frgs.size(); i++)
 	{
 		if(frgs[i][2] <= 0) continue;
 		int h1 = frgs[i][0];
 		int h2 = frgs[i][1];
-		assert(hits[h1].qname == hits[h2].qname);
-		bridged.insert(hits[h1].qname);
-		if((hits[h1].flag & 0x100) <= 0 && (hits[h2].flag & 0x100) <= 0) primary.insert(hits[h1].qname);
+		assert(hits[h1].qhash == hits[h2].qhash);
+		bridged.insert(hits[h1].qhash);
+		if((hits[h1].flag & 0x100) <= 0 && (hits[h2].flag & 0x100) <= 0) primary.insert(hits[h1].qhash);
 	}
 
 	int cnt1 = 0;
@@ -502,7 +753,7 @@ int bundle_base::filter_multialigned_hits()
 		int h1 = frgs[i][0];
 		int h2 = frgs[i][1];
 		if(frgs[i][2] >= 1) continue;
-		if(primary.find(hits[h1].qname) == primary.end()) continue;
+		if(primary.find(hits[h1].qhash) == primary.end()) continue;
 		eliminate_hit(h1);
 		eliminate_hit(h2);
 		frgs[i][2] = -1;
@@ -517,7 +768,7 @@ int bundle_base::filter_multialigned_hits()
 		if(frgs[i][2] <= 0) continue;
 		if((hits[h1].flag & 0x100) <= 0) continue;
 		if((hits[h2].flag & 0x100) <= 0) continue;
-		if(primary.find(hits[h1].qname) == primary.end()) continue;
+		if(primary.find(hits[h1].qhash) == primary.end()) continue;
 		eliminate_bridge(i);
 		eliminate_hit(h1);
 		eliminate_hit(h2);
@@ -539,7 +790,7 @@ int bundle_base::filter_multialigned_hits()
 	for(int i = 0; i < hits.size(); i++)
 	{
 		if(paired[i] == true) continue;
-		if(bridged.find(hits[i].qname) == bridged.end()) continue;
+		if(bridged.find(hits[i].qhash) == bridged.end()) continue;
 		eliminate_hit(i);
 		cnt2++;
 	}
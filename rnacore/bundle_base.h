@@ -11,15 +11,27 @@ See LICENSE for licensing.
 #include <cstring>
 #include <string>
 #include <vector>
+#include <unordered_map>
 
 #include "hit.h"
 #include "interval_map.h"
+#include "coverage_map.h"
 #include "chain_set.h"
 #include "phase_set.h"
 #include "splice_graph.h"
 
 using namespace std;
 
+// a distinct alignment at the current position of a weighted bundle;
+// its coverage and chain are added once the position is passed
+class pending_hit
+{
+public:
+	int index;						// index in hits
+	vector<uint32_t> cigar;			// cigar of the alignment
+	vector<int32_t> chain;			// splice positions of the alignment
+};
+
 class bundle_base
 {
 public:
@@ -32,31 +44,46 @@ public:
 	int32_t lpos;					// the leftmost boundary on reference
 	int32_t rpos;					// the rightmost boundary on reference
 	vector<hit> hits;				// hits
+	string qnames;					// arena of query names of hits, only filled if keep_qnames
+	bool keep_qnames;				// whether names are needed (for bridged alignments)
+	bool weighted;					// whether identical alignments are collapsed into weighted hits
 	vector<AI3> frgs;				// fragments <hit1, hit2, type>, type: -1: cannot be bridged; 0: to-be-bridged; 1: bridge with empty; 2: bridge with extra splices
+	vector<int> fcounts;			// multiplicity of each fragment
 	chain_set hcst;					// chain set for hits 
 	chain_set fcst;					// chain set for frgs
-	split_interval_map mmap;		// matched interval map
-	split_interval_map imap;		// indel interval map
+	coverage_map mmap;				// matched interval map
+	coverage_map imap;				// indel interval map
 
 public:
 	int clear();
+	int release();
+	int build_coverage();
+	int write(ostream &os) const;
+	int read(istream &is);
 	int print(int index);
 	int compute_strand(int libtype);
 	int check_left_ascending();
 	int check_right_ascending();
 	int add_hit_intervals(const hit &ht, bam1_t *b);
+	int flush_weighted_hits();
 	int build_fragments();
 	int build_phase_set(phase_set &ps, splice_graph &gr);
 	int update_bridges(const vector<int> &frlist, const vector<int32_t> &chain);
 	int filter_multialigned_hits();
+	string get_qname(int k) const;
 
 private:
 	int add_hit(const hit &ht);
-	int add_intervals(bam1_t *b);
+	int add_weighted_hit(const hit &ht, bam1_t *b);
+	int add_intervals(int32_t p, const uint32_t *cigar, int n, int w);
 	int filter_secondary_hits();
 	int eliminate_hit(int k);
 	int eliminate_bridge(int k);
 	bool overlap(const hit &ht) const;
+
+private:
+	vector<pending_hit> pending;			// distinct alignments at the current position
+	unordered_map<uint64_t, int> pindex;	// alignment hash to index in pending
 };
 
 #endif
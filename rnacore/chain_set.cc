@@ -8,19 +8,38 @@ See LICENSE for licensing.
 #include "constants.h"
 #include "chain_set.h"
 
+#include <cstring>
+#include <algorithm>
+
 int chain_set::add(const chain_set &cst)
 {
-	for(int i = 0; i < cst.chains.size(); i++)
+	reserve(size() + cst.size(), pool.size() + cst.pool.size());
+	for(int k = 0; k < cst.size(); k++)
 	{
-		for(int j = 0; j < cst.chains[i].size(); j++)  
-		{
-			const PVI3 &p = cst.chains[i][j];
-			add(p.first, p.second);
-		}
+		int x = intern(cst.data(k), cst.length(k));
+		counts[x][0] += cst.counts[k][0];
+		counts[x][1] += cst.counts[k][1];
+		counts[x][2] += cst.counts[k][2];
 	}
 	return 0;
 }
 
+int chain_set::merge(const vector<const chain_set*> &vc, chain_set &cst)
+{
+	// size the pool and table once, then each chain costs one probe
+	int64_t n = cst.size();
+	int64_t m = cst.pool.size();
+	for(int i = 0; i < vc.size(); i++)
+	{
+		n += vc[i]->size();
+		m += vc[i]->pool.size();
+	}
+	cst.reserve(n, m);
+
+	for(int i = 0; i < vc.size(); i++) cst.add(*vc[i]);
+	return 0;
+}
+
 int chain_set::add(const vector<int32_t> &v, const AI3 &a)
 {
 	if(v.size() <= 0)
@@ -29,39 +48,19 @@ int chain_set::add(const vector<int32_t> &v, const AI3 &a)
 		return 0;
 	}
 
-	int32_t p = v[0];
-	if(pmap.find(p) == pmap.end())
-	{
-		vector<PVI3> vv;
-		vv.push_back(PVI3(v, a));
-		chains.push_back(vv);
-		int n = chains.size() - 1;
-		pmap.insert(PI(p, n));
-	}
-	else
-	{
-		int k = pmap[p];
-		assert(k >= 0 && k < chains.size());
-		vector<PVI3> &vv = chains[k];
-		bool found = false;
-		for(int i = 0; i < vv.size(); i++)
-		{
-			if(vv[i].first == v)
-			{
-				vv[i].second[0] += a[0];
-				vv[i].second[1] += a[1];
-				vv[i].second[2] += a[2];
-				found = true;
-				break;
-			}
-		}
-
-		if(found == false) vv.push_back(PVI3(v, a));
-	}
+	int x = intern(v.data(), v.size());
+	counts[x][0] += a[0];
+	counts[x][1] += a[1];
+	counts[x][2] += a[2];
 	return 0;
 }
 
 int chain_set::add(const vector<int32_t> &v, int h, char c)
+{
+	return add(v, h, c, 1);
+}
+
+int chain_set::add(const vector<int32_t> &v, int h, char c, int w)
 {
 	if(v.size() <= 0)
 	{
@@ -69,7 +68,7 @@ int chain_set::add(const vector<int32_t> &v, int h, char c)
 		return 0;
 	}
 
-	if(h >= 0 && hmap.find(h) != hmap.end()) 
+	if(h >= 0 && h < handles.size() && handles[h][0] >= 0)
 	{
 		printf("error: id %d has already been added to chain_set\n", h);
 		return 0;
@@ -79,122 +78,204 @@ int chain_set::add(const vector<int32_t> &v, int h, char c)
 	if(c == '+') xs = 1;
 	if(c == '-') xs = 2;
 
-	int32_t p = v[0];
-	if(pmap.find(p) == pmap.end())
-	{
-		AI3 a = {0, 0, 0};
-		a[xs] = 1;
-		vector<PVI3> vv;
-		vv.push_back(PVI3(v, a));
-		chains.push_back(vv);
-		int n = chains.size() - 1;
-		pmap.insert(PI(p, n));
-		if(h >= 0) hmap.insert(make_pair(h, AI3({n, 0, xs})));
-	}
-	else
-	{
-		int k = pmap[p];
-		assert(k >= 0 && k < chains.size());
-		vector<PVI3> &vv = chains[k];
-		bool found = false;
-		for(int i = 0; i < vv.size(); i++)
-		{
-			if(vv[i].first == v)
-			{
-				if(h >= 0) hmap.insert(make_pair(h, AI3({k, i, xs})));
-				vv[i].second[xs]++;
-				found = true;
-				break;
-			}
-		}
-
-		if(found == false)
-		{
-			AI3 a = {0, 0, 0};
-			a[xs] = 1;
-			vv.push_back(PVI3(v, a));
-			int n = vv.size() - 1;
-			if(h >= 0) hmap.insert(make_pair(h, AI3({k, n, xs})));
-		}
-	}
+	int x = intern(v.data(), v.size());
+	counts[x][xs] += w;
+
+	if(h < 0) return 0;
+	if(h >= handles.size()) handles.resize(h + 1, AI3({-1, -1, 0}));
+	handles[h] = AI3({x, xs, w});
 	return 0;
 }
 
 int chain_set::remove(int h)
 {
-	if(hmap.find(h) == hmap.end()) return 0;
-	AI3 p = hmap[h];
-	assert(p[0] >= 0 && p[0] < chains.size());
-	assert(p[1] >= 0 && p[1] < chains[p[0]].size());
-	assert(p[2] >= 0 && p[2] <= 2);
-	chains[p[0]][p[1]].second[p[2]]--;
-	if(chains[p[0]][p[1]].second[p[2]] <= 0) chains[p[0]][p[1]].second[p[2]] = 0;
-	hmap.erase(h);
+	if(h < 0 || h >= handles.size()) return 0;
+	if(handles[h][0] < 0) return 0;
+	int x = handles[h][0];
+	int xs = handles[h][1];
+	assert(x >= 0 && x < counts.size());
+	assert(xs >= 0 && xs <= 2);
+	counts[x][xs] -= handles[h][2];
+	if(counts[x][xs] <= 0) counts[x][xs] = 0;
+	handles[h] = AI3({-1, -1, 0});
 	return 0;
 }
 
+int chain_set::size() const
+{
+	return counts.size();
+}
+
+int chain_set::length(int k) const
+{
+	return offsets[k + 1] - offsets[k];
+}
+
+const int32_t* chain_set::data(int k) const
+{
+	return pool.data() + offsets[k];
+}
+
 vector<int32_t> chain_set::get_chain(int h) const
 {
 	vector<int32_t> v;
-	if(h < 0) return v;
-	if(hmap.find(h) == hmap.end()) return v;
-	const auto &p = hmap.at(h);
-	return chains[p[0]][p[1]].first;
+	if(h < 0 || h >= handles.size()) return v;
+	int x = handles[h][0];
+	if(x < 0) return v;
+	v.assign(data(x), data(x) + length(x));
+	return v;
 }
 
 PVI3 chain_set::get(int h) const
 {
 	PVI3 pvi;
 	pvi.second = {-1, -1, -1};
-	if(h < 0) return pvi;
-	if(hmap.find(h) == hmap.end()) return pvi;
-	const auto &p = hmap.at(h);
-	return chains[p[0]][p[1]];
+	if(h < 0 || h >= handles.size()) return pvi;
+	int x = handles[h][0];
+	if(x < 0) return pvi;
+	pvi.first.assign(data(x), data(x) + length(x));
+	pvi.second = counts[x];
+	return pvi;
 }
 
 int chain_set::print()
 {
+	int stored = 0;
+	for(int i = 0; i < handles.size(); i++)
+	{
+		if(handles[i][0] >= 0) stored++;
+	}
+
 	map<int, int> m;
-	for(int i = 0; i < chains.size(); i++)
+	for(int k = 0; k < size(); k++)
 	{
-		int n = chains[i].size();
+		int n = length(k) / 2;
 		if(m.find(n) == m.end()) m.insert(make_pair(n, 1));
 		else m[n]++;
 	}
 
-	printf("chain_set: %lu groups, %lu stored hits\n", pmap.size(), hmap.size());
+	printf("chain_set: %d chains, %lu coordinates, %d stored hits\n", size(), pool.size(), stored);
 	for(auto &x : m)
 	{
-		printf("chain_set: %d groups with %d chains\n", x.second, x.first);
+		printf("chain_set: %d chains with %d introns\n", x.second, x.first);
 	}
 	return 0;
 }
 
 int chain_set::clear()
 {
-	hmap.clear();
-	pmap.clear();
-	chains.clear();
+	pool.clear();
+	offsets.clear();
+	counts.clear();
+	handles.clear();
+	table.clear();
+	return 0;
+}
+
+int chain_set::write(ostream &os) const
+{
+	write_binary_vector(os, pool);
+	write_binary_vector(os, offsets);
+	write_binary_vector(os, counts);
+	write_binary_vector(os, handles);
+	return 0;
+}
+
+int chain_set::read(istream &is)
+{
+	clear();
+	read_binary_vector(is, pool);
+	read_binary_vector(is, offsets);
+	read_binary_vector(is, counts);
+	read_binary_vector(is, handles);
+	if(is.fail())
+	{
+		clear();
+		offsets.push_back(0);
+		return -1;
+	}
+	if(offsets.size() == 0) offsets.push_back(0);
+	rehash(size() * 2);
 	return 0;
 }
 
 vector<int32_t> chain_set::get_splices() const
 {
-	set<int32_t> s;
-	for(int i = 0; i < chains.size(); i++)
+	vector<int32_t> v;
+	for(int k = 0; k < size(); k++)
 	{
-		for(int j = 0; j < chains[i].size(); j++)
-		{
-			const PVI3 &p = chains[i][j];
-			if(p.second[0] + p.second[1] + p.second[2] <= 0) continue;
-			for(int k = 0; k < p.first.size(); k++)
-			{
-				s.insert(p.first[k]);
-			}
-		}
+		const AI3 &a = counts[k];
+		if(a[0] + a[1] + a[2] <= 0) continue;
+		v.insert(v.end(), data(k), data(k) + length(k));
 	}
 
-	vector<int32_t> v(s.begin(), s.end());
 	sort(v.begin(), v.end());
+	v.erase(unique(v.begin(), v.end()), v.end());
 	return v;
 }
+
+int chain_set::intern(const int32_t *v, int n)
+{
+	if(offsets.size() == 0) offsets.push_back(0);
+	if((counts.size() + 1) * 2 > table.size()) rehash((counts.size() + 1) * 2);
+
+	size_t x = hash(v, n);
+	int k = locate(v, n, x);
+	if(table[k] >= 0) return table[k];
+
+	table[k] = counts.size();
+	pool.insert(pool.end(), v, v + n);
+	offsets.push_back(pool.size());
+	counts.push_back(AI3({0, 0, 0}));
+	return table[k];
+}
+
+int chain_set::locate(const int32_t *v, int n, size_t x) const
+{
+	// slot holding chain v, or the empty slot where it belongs
+	size_t mask = table.size() - 1;
+	size_t k = x & mask;
+	while(table[k] >= 0)
+	{
+		int c = table[k];
+		if(length(c) == n && memcmp(data(c), v, n * sizeof(int32_t)) == 0) break;
+		k = (k + 1) & mask;
+	}
+	return k;
+}
+
+int chain_set::reserve(int64_t chains, int64_t coordinates)
+{
+	pool.reserve(coordinates);
+	offsets.reserve(chains + 1);
+	counts.reserve(chains);
+	if(chains * 2 > table.size()) rehash(chains * 2);
+	return 0;
+}
+
+int chain_set::rehash(int slots)
+{
+	int m = 16;
+	while(m < slots) m = m << 1;
+	if(m <= table.size()) return 0;
+
+	table.assign(m, -1);
+	for(int k = 0; k < size(); k++)
+	{
+		int x = locate(data(k), length(k), hash(data(k), length(k)));
+		table[x] = k;
+	}
+	return 0;
+}
+
+size_t chain_set::hash(const int32_t *v, int n)
+{
+	// FNV-1a over the coordinates
+	uint64_t x = 14695981039346656037ULL;
+	for(int i = 0; i < n; i++)
+	{
+		x ^= (uint32_t)v[i];
+		x *= 1099511628211ULL;
+	}
+	return x ^ (x >> 29);
+}
@@ -15,23 +15,43 @@ See LICENSE for licensing.
 
 using namespace std;
 
+// interned intron chains: chain k occupies pool[offsets[k], offsets[k + 1])
+// and is found through an open-addressing table hashed on its coordinates
 class chain_set
 {
 public:
-	map<int, AI3> hmap;
-	map<int32_t, int> pmap;
-	vector<vector<PVI3>> chains;
+	vector<int32_t> pool;		// coordinates of all chains, concatenated
+	vector<int64_t> offsets;	// start of each chain in pool, plus the end
+	vector<AI3> counts;			// counts of each chain by strand
+	vector<AI3> handles;		// chain id, strand and weight of each handle, chain id -1 if absent
+	vector<int> table;			// hash slots holding chain ids, -1 if empty
 
 public:
-	int add(const chain_set &cst);							// if h < 0, don't store the handle
+	int add(const chain_set &cst);							// merge counts of cst, handles are not kept
 	int add(const vector<int32_t> &v, const AI3 &a);	// if h < 0, don't store the handle
 	int add(const vector<int32_t> &v, int h, char xs);	// if h < 0, don't store the handle
-	int remove(int h);									// remove handle and decrease count
+	int add(const vector<int32_t> &v, int h, char xs, int w);	// add with weight w
+	int remove(int h);									// remove handle and decrease count by its weight
 	int clear();										// clear everything
 	int print();										// print
+	int write(ostream &os) const;						// binary serialization
+	int read(istream &is);								// binary deserialization
+	int size() const;									// number of distinct chains
+	int length(int k) const;							// number of coordinates of chain k
+	const int32_t* data(int k) const;					// coordinates of chain k
 	PVI3 get(int h) const;								// get chain and return count
 	vector<int32_t> get_chain(int h) const;				// get chain
 	vector<int32_t> get_splices() const;				// get the set of all splices
+
+public:
+	static int merge(const vector<const chain_set*> &vc, chain_set &cst);
+
+private:
+	int intern(const int32_t *v, int n);				// id of chain v, added if absent
+	int locate(const int32_t *v, int n, size_t x) const;
+	int reserve(int64_t chains, int64_t coordinates);
+	int rehash(int slots);
+	static size_t hash(const int32_t *v, int n);
 };
 
 #endif
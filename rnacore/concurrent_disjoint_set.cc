@@ -0,0 +1,67 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#include "concurrent_disjoint_set.h"
+
+concurrent_disjoint_set::concurrent_disjoint_set(int n)
+	: parents(n), sizes(n, 1), stripes(64)
+{
+	for(int k = 0; k < n; k++) parents[k].store(k);
+}
+
+int concurrent_disjoint_set::find_set(int x)
+{
+	while(true)
+	{
+		int p = parents[x].load();
+		if(p == x) return x;
+		int q = parents[p].load();
+		if(q == p) return p;
+
+		// path halving, losing the race is harmless
+		parents[x].compare_exchange_weak(p, q);
+		x = q;
+	}
+	return x;
+}
+
+int concurrent_disjoint_set::get_size(int p)
+{
+	lock_guard<mutex> lk(stripes[p % stripes.size()]);
+	return sizes[p];
+}
+
+bool concurrent_disjoint_set::link_capped(int x, int y, int cap)
+{
+	while(true)
+	{
+		int px = find_set(x);
+		int py = find_set(y);
+		if(px == py) return false;
+
+		int a = px % stripes.size();
+		int b = py % stripes.size();
+		if(a > b) swap(a, b);
+		unique_lock<mutex> la(stripes[a]);
+		unique_lock<mutex> lb;
+		if(a != b) lb = unique_lock<mutex>(stripes[b]);
+
+		// roots may have been linked before locking
+		if(parents[px].load() != px) continue;
+		if(parents[py].load() != py) continue;
+
+		int sx = sizes[px];
+		int sy = sizes[py];
+		if(sx >= cap) return false;
+		if(sy >= cap) return false;
+
+		if(sx < sy || (sx == sy && px > py)) swap(px, py);
+		parents[py].store(px);
+		sizes[px] = sx + sy;
+		return true;
+	}
+	return false;
+}
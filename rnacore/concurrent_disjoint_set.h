@@ -0,0 +1,34 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#ifndef __CONCURRENT_DISJOINT_SET_H__
+#define __CONCURRENT_DISJOINT_SET_H__
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+using namespace std;
+
+// union-find shared by threads: find_set is lock-free,
+// link_capped locks only the stripes of the two roots
+class concurrent_disjoint_set
+{
+public:
+	concurrent_disjoint_set(int n);
+
+public:
+	int find_set(int x);
+	int get_size(int p);
+	bool link_capped(int x, int y, int cap);
+
+private:
+	vector<atomic<int>> parents;
+	vector<int> sizes;				// valid at roots, guarded by stripes
+	vector<mutex> stripes;
+};
+
+#endif
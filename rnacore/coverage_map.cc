@@ -0,0 +1,348 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#include "coverage_map.h"
+
+#include <cassert>
+#include <cmath>
+#include <queue>
+#include <algorithm>
+#include <functional>
+
+int coverage_map::add(int32_t l, int32_t r, int32_t w)
+{
+	if(l >= r) return 0;
+	if(w == 0) return 0;
+	events.push_back(PI32(l, w));
+	events.push_back(PI32(r, -w));
+	return 0;
+}
+
+int coverage_map::add(const coverage_map &m)
+{
+	for(int i = 0; i < m.segs.size(); i++)
+	{
+		add(lower(m.segs[i].first), upper(m.segs[i].first), m.segs[i].second);
+	}
+	events.insert(events.end(), m.events.begin(), m.events.end());
+	return 0;
+}
+
+int coverage_map::build()
+{
+	if(events.size() == 0) return 0;
+
+	sort(events.begin(), events.end());
+
+	vector<PI32> v;
+	build_events(segs, v);
+
+	vector<const vector<PI32>*> vv;
+	vv.push_back(&v);
+	vv.push_back(&events);
+
+	vector<coverage_segment> z;
+	sweep(vv, z);
+	segs = std::move(z);
+	vector<PI32>().swap(events);
+	return 0;
+}
+
+int coverage_map::merge(const vector<const coverage_map*> &v, coverage_map &m)
+{
+	vector<vector<PI32>> ev(v.size() + 1);
+	vector<const vector<PI32>*> vv;
+	for(int i = 0; i < v.size(); i++)
+	{
+		assert(v[i]->built());
+		build_events(v[i]->segs, ev[i]);
+		vv.push_back(&ev[i]);
+	}
+
+	// segments and pending events of m itself
+	m.build();
+	build_events(m.segs, ev[v.size()]);
+	vv.push_back(&ev[v.size()]);
+
+	vector<coverage_segment> z;
+	sweep(vv, z);
+	m.segs = std::move(z);
+	return 0;
+}
+
+int coverage_map::build_events(const vector<coverage_segment> &segs, vector<PI32> &v)
+{
+	// segments are disjoint, so the events are sorted
+	v.clear();
+	v.reserve(segs.size() * 2);
+	for(int i = 0; i < segs.size(); i++)
+	{
+		v.push_back(PI32(lower(segs[i].first), segs[i].second));
+		v.push_back(PI32(upper(segs[i].first), -segs[i].second));
+	}
+	return 0;
+}
+
+int coverage_map::sweep(const vector<const vector<PI32>*> &vv, vector<coverage_segment> &segs)
+{
+	// k-way merge of sorted event lists; every event position is a
+	// boundary, as in split_interval_map, and zero segments are dropped
+	typedef pair<int32_t, int> PPI;
+	priority_queue<PPI, vector<PPI>, greater<PPI>> heap;
+	vector<int> cursor(vv.size(), 0);
+	for(int k = 0; k < vv.size(); k++)
+	{
+		if(vv[k]->size() >= 1) heap.push(PPI(vv[k]->front().first, k));
+	}
+
+	segs.clear();
+	int32_t w = 0;
+	int32_t p = 0;
+	bool started = false;
+	while(heap.empty() == false)
+	{
+		int32_t x = heap.top().first;
+		if(started == true && x > p && w != 0) segs.push_back(coverage_segment(ROI(p, x), w));
+
+		while(heap.empty() == false && heap.top().first == x)
+		{
+			int k = heap.top().second;
+			heap.pop();
+			const vector<PI32> &v = *(vv[k]);
+			while(cursor[k] < v.size() && v[cursor[k]].first == x)
+			{
+				w += v[cursor[k]].second;
+				cursor[k]++;
+			}
+			if(cursor[k] < v.size()) heap.push(PPI(v[cursor[k]].first, k));
+		}
+
+		p = x;
+		started = true;
+	}
+	assert(w == 0);
+	return 0;
+}
+
+int coverage_map::clear()
+{
+	segs.clear();
+	events.clear();
+	return 0;
+}
+
+int coverage_map::release()
+{
+	vector<coverage_segment>().swap(segs);
+	vector<PI32>().swap(events);
+	return 0;
+}
+
+bool coverage_map::built() const
+{
+	return (events.size() == 0);
+}
+
+CMI coverage_map::find(int32_t p) const
+{
+	assert(built());
+	CMI it = upper_bound(segs.begin(), segs.end(), p, [](int32_t x, const coverage_segment &s){ return x < lower(s.first); });
+	if(it == segs.begin()) return segs.end();
+	it--;
+	if(upper(it->first) <= p) return segs.end();
+	return it;
+}
+
+int coverage_map::write(ostream &os) const
+{
+	assert(built());
+	int64_t n = segs.size();
+	write_binary(os, n);
+	for(int i = 0; i < segs.size(); i++)
+	{
+		write_binary(os, lower(segs[i].first));
+		write_binary(os, upper(segs[i].first));
+		write_binary(os, segs[i].second);
+	}
+	return 0;
+}
+
+int coverage_map::read(istream &is)
+{
+	clear();
+	int64_t n = 0;
+	read_binary(is, n);
+	if(check_binary_count(is, n, 3 * sizeof(int32_t)) == false) return -1;
+	segs.reserve(n);
+	for(int64_t i = 0; i < n && is.good(); i++)
+	{
+		int32_t l, u, w;
+		read_binary(is, l);
+		read_binary(is, u);
+		read_binary(is, w);
+		segs.push_back(coverage_segment(ROI(l, u), w));
+	}
+	return 0;
+}
+
+int compute_overlap(const coverage_map &cmap, int32_t p)
+{
+	CMI it = cmap.find(p);
+	if(it == cmap.end()) return 0;
+	return it->second;
+}
+
+CMI locate_right_iterator(const coverage_map &cmap, int32_t x)
+{
+	// the first segment with lower position >= x
+	assert(cmap.built());
+	return lower_bound(cmap.begin(), cmap.end(), x, [](const coverage_segment &s, int32_t x){ return lower(s.first) < x; });
+}
+
+CMI locate_left_iterator(const coverage_map &cmap, int32_t x)
+{
+	// the last segment with upper position <= x
+	assert(cmap.built());
+	CMI it = upper_bound(cmap.begin(), cmap.end(), x, [](int32_t x, const coverage_segment &s){ return x < upper(s.first); });
+	if(it == cmap.begin()) return cmap.end();
+	it--;
+	return it;
+}
+
+PCMI locate_boundary_iterators(const coverage_map &cmap, int32_t x, int32_t y)
+{
+	CMI lit, rit;
+	lit = locate_right_iterator(cmap, x);
+	if(lit == cmap.end() || upper(lit->first) > y) lit = cmap.end();
+
+	rit = locate_left_iterator(cmap, y);
+	if(rit == cmap.end() || lower(rit->first) < x) rit = cmap.end();
+
+	if(lit == cmap.end()) assert(rit == cmap.end());
+	if(rit == cmap.end()) assert(lit == cmap.end());
+
+	return PCMI(lit, rit); 
+}
+
+int compute_coverage(const coverage_map &cmap, CMI &p, CMI &q)
+{
+	if(p == cmap.end()) return 0;
+
+	int32_t s = 0;
+	for(CMI it = p; it != q; it++) s += upper(it->first) - lower(it->first);
+	if(q != cmap.end()) s += upper(q->first) - lower(q->first);
+	return s;
+}
+
+int compute_max_overlap(const coverage_map &cmap, CMI &p, CMI &q)
+{
+	if(p == cmap.end()) return 0;
+
+	int32_t s = 0;
+	for(CMI it = p; it != q; it++) s = max(s, it->second);
+	if(q != cmap.end()) s = max(s, q->second);
+	return s;
+}
+
+int compute_sum_overlap(const coverage_map &cmap, CMI &p, CMI &q)
+{
+	if(p == cmap.end()) return 0;
+
+	int32_t s = 0;
+	for(CMI it = p; it != q; it++)
+	{
+		assert(upper(it->first) > lower(it->first));
+		s += (upper(it->first) - lower(it->first)) * it->second;
+	}
+	if(q != cmap.end()) s += (upper(q->first) - lower(q->first)) * q->second;
+	return s;
+}
+
+int evaluate_rectangle(const coverage_map &cmap, int ll, int rr, double &ave, double &dev, double &max)
+{
+	ave = 0;
+	dev = 1;
+	max = 0;
+
+	PCMI pei = locate_boundary_iterators(cmap, ll, rr);
+	CMI lit = pei.first, rit = pei.second;
+
+	if(lit == cmap.end()) return 0;
+	if(rit == cmap.end()) return 0;
+
+	max = 1.0 * compute_max_overlap(cmap, lit, rit);
+	ave = 1.0 * compute_sum_overlap(cmap, lit, rit) / (rr - ll);
+
+	double var = 0;
+	for(CMI it = lit; ; it++)
+	{
+		assert(upper(it->first) > lower(it->first));
+		var += (it->second - ave) * (it->second - ave) * (upper(it->first) - lower(it->first));
+		if(it == rit) break;
+	}
+
+	dev = sqrt(var / (rr - ll));
+	return 0;
+}
+
+int evaluate_triangle(const coverage_map &cmap, int ll, int rr, double &ave, double &dev)
+{
+	ave = 0;
+	dev = 1.0;
+
+	PCMI pei = locate_boundary_iterators(cmap, ll, rr);
+	CMI lit = pei.first, rit = pei.second;
+
+	if(lit == cmap.end()) return 0;
+	if(rit == cmap.end()) return 0;
+
+	vector<double> xv;
+	vector<double> yv;
+	double xm = 0;
+	double ym = 0;
+	for(CMI it = lit; ; it++)
+	{
+		double xi = (lower(it->first) + upper(it->first)) / 2.0;
+		double yi = it->second;
+		xv.push_back(xi);
+		yv.push_back(yi);
+		xm += xi;
+		ym += yi;
+		if(it == rit) break;
+	}
+
+	xm /= xv.size();
+	ym /= yv.size();
+
+	double f1 = 0;
+	double f2 = 0;
+	for(int i = 0; i < xv.size(); i++)
+	{
+		f1 += (xv[i] - xm) * (yv[i] - ym);
+		f2 += (xv[i] - xm) * (xv[i] - xm);
+	}
+
+	double b1 = f1 / f2;
+	double b0 = ym - b1 * xm;
+
+	double a1 = b1 * rr + b0;
+	double a0 = b1 * ll + b0;
+	ave = (a1 > a0) ? a1 : a0;
+
+	double var = 0;
+	for(CMI it = lit; ; it++)
+	{
+		double xi = (upper(it->first) + lower(it->first)) / 2.0;
+		double yi = b1 * xi + b0;
+		var += (it->second - yi) * (it->second - yi) * (upper(it->first) - lower(it->first));
+		if(it == rit) break;
+	}
+
+	dev = sqrt(var / (rr - ll));
+	if(dev < 1.0) dev = 1.0;
+
+	return 0;
+}
@@ -0,0 +1,66 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#ifndef __COVERAGE_MAP_H__
+#define __COVERAGE_MAP_H__
+
+#include "interval_map.h"
+#include "util.h"
+
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+typedef pair<ROI, int32_t> coverage_segment;
+typedef vector<coverage_segment>::const_iterator CMI;
+typedef pair<CMI, CMI> PCMI;
+
+// flat replacement of split_interval_map<int32_t, int32_t>:
+// segments are sorted, disjoint and nonzero, and split at every
+// boundary of the added intervals; intervals are buffered as
+// events and swept into segments in bulk by build()
+class coverage_map
+{
+public:
+	vector<coverage_segment> segs;	// built segments
+	vector<PI32> events;			// pending <position, delta>
+
+public:
+	int add(int32_t l, int32_t r, int32_t w);
+	int add(const coverage_map &m);
+	int build();
+	int clear();
+	int release();
+	bool built() const;
+	int write(ostream &os) const;
+	int read(istream &is);
+
+	CMI begin() const { return segs.begin(); }
+	CMI end() const { return segs.end(); }
+	size_t size() const { return segs.size(); }
+	CMI find(int32_t p) const;
+
+	// merge built maps in one k-way sweep
+	static int merge(const vector<const coverage_map*> &v, coverage_map &m);
+
+private:
+	static int build_events(const vector<coverage_segment> &segs, vector<PI32> &v);
+	static int sweep(const vector<const vector<PI32>*> &vv, vector<coverage_segment> &segs);
+};
+
+// the same queries as for split_interval_map, see interval_map.h
+int compute_overlap(const coverage_map &cmap, int32_t p);
+CMI locate_right_iterator(const coverage_map &cmap, int32_t x);
+CMI locate_left_iterator(const coverage_map &cmap, int32_t x);
+PCMI locate_boundary_iterators(const coverage_map &cmap, int32_t x, int32_t y);
+int compute_coverage(const coverage_map &cmap, CMI &p, CMI &q);
+int compute_max_overlap(const coverage_map &cmap, CMI &p, CMI &q);
+int compute_sum_overlap(const coverage_map &cmap, CMI &p, CMI &q);
+int evaluate_rectangle(const coverage_map &cmap, int ll, int rr, double &ave, double &dev, double &max);
+int evaluate_triangle(const coverage_map &cmap, int ll, int rr, double &ave, double &dev);
+
+#endif
@@ -12,6 +12,7 @@ See LICENSE for licensing.
 #include <algorithm>
 #include <cstdio>
 #include <cstring>
+#include <cstdlib>
 
 int build_child_splice_graph(splice_graph &root, splice_graph &gr, map<int, int> &a2b)
 {
@@ -176,10 +177,9 @@ int check_strand_from_intron_coordinates(splice_graph &gr, const vector<int32_t>
 		int32_t q = v[2 * k + 1];
 		assert(p >= 0 && q >= 0);
 		if(p >= q) return -1;
-		if(gr.rindex.find(p) == gr.rindex.end()) return -1;
-		if(gr.lindex.find(q) == gr.lindex.end()) return -1;
-		int kp = gr.rindex[p];
-		int kq = gr.lindex[q];
+		int kp = gr.rindex.find(p);
+		int kq = gr.lindex.find(q);
+		if(kp < 0 || kq < 0) return -1;
 
 		PEB pe = gr.edge(kp, kq);
 		if(pe.second == false) return -1;
@@ -218,10 +218,9 @@ bool build_path_from_exon_coordinates(splice_graph &gr, const vector<int32_t> &v
 
 		assert(p >= 0 && q >= 0);
 		if(p >= q) return false;
-		if(gr.lindex.find(p) == gr.lindex.end()) return false;
-		if(gr.rindex.find(q) == gr.rindex.end()) return false;
-		int kp = gr.lindex[p];
-		int kq = gr.rindex[q];
+		int kp = gr.lindex.find(p);
+		int kq = gr.rindex.find(q);
+		if(kp < 0 || kq < 0) return false;
 		pp[k].first = kp;
 		pp[k].second = kq;
 	}
@@ -257,10 +256,9 @@ bool build_path_from_intron_coordinates(splice_graph &gr, const vector<int32_t>
 		int32_t q = v[2 * k + 1];
 		assert(p >= 0 && q >= 0);
 		if(p >= q) return false;
-		if(gr.rindex.find(p) == gr.rindex.end()) return false;
-		if(gr.lindex.find(q) == gr.lindex.end()) return false;
-		int kp = gr.rindex[p];
-		int kq = gr.lindex[q];
+		int kp = gr.rindex.find(p);
+		int kq = gr.lindex.find(q);
+		if(kp < 0 || kq < 0) return false;
 		pp[k].first = kp;
 		pp[k].second = kq;
 	}
@@ -399,8 +397,9 @@ bool build_bam1_t(bam1_t &b1t, const hit_core &h, const vector<int32_t> &chain)
 	b1t.core.isize = h.isize;
 	b1t.core.flag = h.flag;
 
+	// malloc, as htslib reallocates and frees the data
 	b1t.m_data = b1t.core.l_qname + 4 * (chain.size() + 1) + 7 * 3;
-	b1t.data = new uint8_t[b1t.m_data];
+	b1t.data = (uint8_t*)malloc(b1t.m_data);
 
 	// copy qname
 	b1t.l_data = 0;
@@ -454,8 +453,9 @@ bool build_bam1_t(bam1_t &b1t, const hit_core &h1, const hit_core &h2, const vec
 	b1t.core.flag = h1.flag;
 	//b1t.core.flag -= b1t.core.flag & (0x1);
 
+	// malloc, as htslib reallocates and frees the data
 	b1t.m_data = b1t.core.l_qname + 4 * (chain.size() + 1) + 7 * 3;
-	b1t.data = new uint8_t[b1t.m_data];
+	b1t.data = (uint8_t*)malloc(b1t.m_data);
 
 	// copy qname
 	b1t.l_data = 0;
@@ -502,57 +502,43 @@ bool build_bam1_t(bam1_t &b1t, const hit_core &h1, const hit_core &h2, const vec
 	return true;
 }
 
-int write_bridged_pereads_cluster(BGZF *fout, const pereads_cluster &pc, const vector<int32_t> &whole)
+int build_bridged_pereads_cluster(const pereads_cluster &pc, const vector<int32_t> &whole, vector<bam1_t*> &vb)
 {
 	assert(pc.hits1.size() == pc.hits2.size());
 	if(pc.hits1.size() == 0) return 0;
 
 	for(int i = 0; i < pc.hits1.size(); i++)
 	{
-		const hit &h1 = pc.hits1[i];
-		const hit &h2 = pc.hits2[i];
+		const hit_core &h1 = pc.hits1[i];
+		const hit_core &h2 = pc.hits2[i];
 
-		bam1_t b1t;
-
-		/*
-		printf("write bam1 (%d, %d) -- (%d, %d), whole = ( ", h1.pos, h1.rpos, h2.pos, h2.rpos);
-		printv(whole);
-		printf("\n");
-		*/
-
-		bool b = build_bam1_t(b1t, h1, h2, whole);
-		if(b == true) bam_write1(fout, &(b1t));
-		assert(b1t.data != NULL);
-		delete b1t.data;
+		bam1_t *b1t = bam_init1();
+		bool b = build_bam1_t(*b1t, h1, h2, whole);
+		if(b == true) vb.push_back(b1t);
+		else bam_destroy1(b1t);
 	}
 	return 0;
 }
 
-int write_unbridged_pereads_cluster(BGZF *fout, const pereads_cluster &pc)
+int build_unbridged_pereads_cluster(const pereads_cluster &pc, vector<bam1_t*> &vb)
 {
 	assert(pc.hits1.size() == pc.hits2.size());
 	if(pc.hits1.size() == 0) return 0;
 
 	for(int i = 0; i < pc.hits1.size(); i++)
 	{
-		const hit &h1 = pc.hits1[i];
-
-		bam1_t b1t;
-		bool b = build_bam1_t(b1t, h1, pc.chain1);
-		if(b == true) bam_write1(fout, &(b1t));
-		assert(b1t.data != NULL);
-		delete b1t.data;
+		bam1_t *b1t = bam_init1();
+		bool b = build_bam1_t(*b1t, pc.hits1[i], pc.chain1);
+		if(b == true) vb.push_back(b1t);
+		else bam_destroy1(b1t);
 	}
 
 	for(int i = 0; i < pc.hits2.size(); i++)
 	{
-		const hit &h2 = pc.hits2[i];
-
-		bam1_t b1t;
-		bool b = build_bam1_t(b1t, h2, pc.chain2);
-		if(b == true) bam_write1(fout, &(b1t));
-		assert(b1t.data != NULL);
-		delete b1t.data;
+		bam1_t *b1t = bam_init1();
+		bool b = build_bam1_t(*b1t, pc.hits2[i], pc.chain2);
+		if(b == true) vb.push_back(b1t);
+		else bam_destroy1(b1t);
 	}
 	return 0;
 }
@@ -23,6 +23,7 @@ graph_builder::graph_builder(bundle_base &b, const parameters &c, const sample_p
 
 int graph_builder::build(splice_graph &gr)
 {
+	bd.build_coverage();
 	build_junctions();
 	remove_opposite_junctions();
 	build_regions();
@@ -46,73 +47,62 @@ int graph_builder::clear()
 int graph_builder::build_junctions()
 {
 	chain_set jcst;
+	const chain_set *vc[2] = {&(bd.hcst), &(bd.fcst)};
 
-	for(int i = 0; i < bd.hcst.chains.size(); i++)
+	for(int c = 0; c < 2; c++)
 	{
-		for(int j = 0; j < bd.hcst.chains[i].size(); j++)
+		const chain_set &cst = *(vc[c]);
+		vector<int32_t> z(2);
+		for(int i = 0; i < cst.size(); i++)
 		{
-			vector<int32_t> &v = bd.hcst.chains[i][j].first;
-			AI3 &a = bd.hcst.chains[i][j].second;
+			const int32_t *v = cst.data(i);
+			const AI3 &a = cst.counts[i];
+			int n = cst.length(i);
 
-			if(v.size() <= 0) continue;
-			if(v.size() % 2 != 0) continue;
+			if(n <= 0) continue;
+			if(n % 2 != 0) continue;
 
-			for(int k = 0; k < v.size() / 2; k++)
+			for(int k = 0; k < n / 2; k++)
 			{
-				vector<int32_t> z;
-				z.push_back(v[k * 2 + 0]);
-				z.push_back(v[k * 2 + 1]);
+				z[0] = v[k * 2 + 0];
+				z[1] = v[k * 2 + 1];
 				jcst.add(z, a);
 			}
 		}
 	}
 
-	for(int i = 0; i < bd.fcst.chains.size(); i++)
+	// visit junctions by coordinates so the result does not depend on insertion order
+	vector<TI32> vv;
+	for(int i = 0; i < jcst.size(); i++)
 	{
-		for(int j = 0; j < bd.fcst.chains[i].size(); j++)
-		{
-			vector<int32_t> &v = bd.fcst.chains[i][j].first;
-			AI3 &a = bd.fcst.chains[i][j].second;
-
-			if(v.size() <= 0) continue;
-			if(v.size() % 2 != 0) continue;
-
-			for(int k = 0; k < v.size() / 2; k++)
-			{
-				vector<int32_t> z;
-				z.push_back(v[k * 2 + 0]);
-				z.push_back(v[k * 2 + 1]);
-				jcst.add(z, a);
-			}
-		}
+		if(jcst.length(i) != 2) continue;
+		vv.push_back(TI32(PI32(jcst.data(i)[0], jcst.data(i)[1]), i));
 	}
+	sort(vv.begin(), vv.end());
 
-	for(int i = 0; i < jcst.chains.size(); i++)
+	for(int i = 0; i < vv.size(); i++)
 	{
-		for(int j = 0; j < jcst.chains[i].size(); j++)
-		{
-			vector<int32_t> &v = jcst.chains[i][j].first;
-			AI3 &a = jcst.chains[i][j].second;
+		int32_t l = vv[i].first.first;
+		int32_t r = vv[i].first.second;
+		const AI3 &a = jcst.counts[vv[i].second];
 
-			if(v.size() != 2) continue;
-			if(v[0] >= v[1]) continue;
+		if(l >= r) continue;
 
-			int count = a[0] + a[1] + a[2];
-			if(count < cfg.min_junction_support) continue;
+		int count = a[0] + a[1] + a[2];
+		if(count < cfg.min_junction_support) continue;
 
-			junction jc(v[0], v[1], count);
-			jc.xs0 = a[0];
-			jc.xs1 = a[1];
-			jc.xs2 = a[2];
+		junction jc(l, r, count);
+		jc.xs0 = a[0];
+		jc.xs1 = a[1];
+		jc.xs2 = a[2];
 
-			if(jc.xs1 > jc.xs2) jc.strand = '+';
-			else if(jc.xs1 < jc.xs2) jc.strand = '-';
-			else jc.strand = '.';
+		if(jc.xs1 > jc.xs2) jc.strand = '+';
+		else if(jc.xs1 < jc.xs2) jc.strand = '-';
+		else jc.strand = '.';
 
-			//if(cfg.verbose >= 2) jc.print("chr1", i);
+		//if(cfg.verbose >= 2) jc.print("chr1", i);
 
-			junctions.push_back(jc);
-		}
+		junctions.push_back(jc);
 	}
 
 	return 0;
@@ -11,11 +11,18 @@ See LICENSE for licensing.
 #include <algorithm>
 
 graph_cluster::graph_cluster(splice_graph &g, bundle_base &d, int max_gap, bool b)
-	: gr(g), bd(d), max_partition_gap(max_gap), store_hits(b)
+	: gr(g), bd(d), max_partition_gap(max_gap), store_hits(b), skip(NULL)
 {
 	group_pereads();
 } 
 
+graph_cluster::graph_cluster(splice_graph &g, bundle_base &d, int max_gap, bool b, const vector<bool> &s)
+	: gr(g), bd(d), max_partition_gap(max_gap), store_hits(b), skip(&s)
+{
+	assert(s.size() == d.frgs.size());
+	group_pereads();
+} 
+
 int graph_cluster::build_pereads_clusters(vector<pereads_cluster> &vc)
 {
 	for(int k = 0; k < groups.size(); k++)
@@ -130,32 +137,35 @@ int graph_cluster::build_pereads_clusters(int g, vector<pereads_cluster> &vc)
 		bounds[2] = bd.hits[h2].pos;
 		bounds[3] = bd.hits[h2].rpos;
 
+		int64_t sums[4] = {0, 0, 0, 0};
 		for(int k = 0; k < zz[i].size(); k++)
 		{
 			h1 = bd.frgs[fs[zz[i][k]]][0];
 			h2 = bd.frgs[fs[zz[i][k]]][1];
+			int w = bd.fcounts[fs[zz[i][k]]];
 
-			pc.bounds[0] += bd.hits[h1].pos  - bounds[0];
-			pc.bounds[1] += bd.hits[h1].rpos - bounds[1];
-			pc.bounds[2] += bd.hits[h2].pos  - bounds[2];
-			pc.bounds[3] += bd.hits[h2].rpos - bounds[3];
+			sums[0] += (int64_t)(bd.hits[h1].pos  - bounds[0]) * w;
+			sums[1] += (int64_t)(bd.hits[h1].rpos - bounds[1]) * w;
+			sums[2] += (int64_t)(bd.hits[h2].pos  - bounds[2]) * w;
+			sums[3] += (int64_t)(bd.hits[h2].rpos - bounds[3]) * w;
 
 			pc.frlist.push_back(fs[zz[i][k]]);
-			pc.count++;
+			pc.count += w;
 			
 			if(store_hits == true)
 			{
-				pc.hits1.push_back(bd.hits[h1]);
-				pc.hits2.push_back(bd.hits[h2]);
+				pc.hits1.push_back(hit_core(bd.hits[h1], bd.get_qname(h1)));
+				pc.hits2.push_back(hit_core(bd.hits[h2], bd.get_qname(h2)));
 			}
 		}
 
 		if(pc.count <= 0) continue;
+		if(all_skipped(pc.frlist) == true) continue;
 
-		pc.bounds[0] = pc.bounds[0] / pc.count + bounds[0];  
-		pc.bounds[1] = pc.bounds[1] / pc.count + bounds[1];
-		pc.bounds[2] = pc.bounds[2] / pc.count + bounds[2]; 
-		pc.bounds[3] = pc.bounds[3] / pc.count + bounds[3];
+		pc.bounds[0] = sums[0] / pc.count + bounds[0];  
+		pc.bounds[1] = sums[1] / pc.count + bounds[1];
+		pc.bounds[2] = sums[2] / pc.count + bounds[2]; 
+		pc.bounds[3] = sums[3] / pc.count + bounds[3];
 		pc.extend[0] = extend[g * 4 + 0];
 		pc.extend[1] = extend[g * 4 + 1];
 		pc.extend[2] = extend[g * 4 + 2];
@@ -167,6 +177,17 @@ int graph_cluster::build_pereads_clusters(int g, vector<pereads_cluster> &vc)
 	return 0;
 }
 
+bool graph_cluster::all_skipped(const vector<int> &frlist) const
+{
+	// skipped fragments still shape the clusters they share with others
+	if(skip == NULL) return false;
+	for(int i = 0; i < frlist.size(); i++)
+	{
+		if((*skip)[frlist[i]] == false) return false;
+	}
+	return true;
+}
+
 vector< vector<int> > graph_cluster::partition(vector< vector<int32_t> > &fs, int r)
 {
 	vector< vector<int> > vv;
@@ -18,6 +18,7 @@ class graph_cluster
 {
 public:
 	graph_cluster(splice_graph &gr, bundle_base &bd, int max_gap, bool b);
+	graph_cluster(splice_graph &gr, bundle_base &bd, int max_gap, bool b, const vector<bool> &skip);
 
 public:
 	splice_graph &gr;				// given splice graph
@@ -28,6 +29,7 @@ private:
 	vector<int32_t> extend;
 	int max_partition_gap;
 	bool store_hits;
+	const vector<bool> *skip;		// fragments not to re-solve, may be NULL; clusters made only of them are dropped
 
 public:
 	int build_pereads_clusters(vector<pereads_cluster> &vc);
@@ -35,6 +37,7 @@ public:
 private:
 	int group_pereads();
 	int build_pereads_clusters(int g, vector<pereads_cluster> &vc);
+	bool all_skipped(const vector<int> &frlist) const;
 	vector<vector<int>> partition(vector<vector<int32_t>> &fs, int r);
 };
 
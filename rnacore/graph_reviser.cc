@@ -1304,16 +1304,17 @@ int remove_false_boundaries(splice_graph &gr, bundle_base &bb, const parameters
 
 		//printf("%s: u1 = %d, %d-%d, u2 = %d, %d-%d, h1.rpos = %d, h2.lpos = %d\n", h1.qname.c_str(), u1, v1.lpos, v1.rpos, u2, v2.lpos, v2.rpos, h1.rpos, h2.pos);
 
+		int w = bb.fcounts[i];
 		if(gr.get_vertex_info(u1).rpos == h1.rpos)
 		{
-			if(fb1.find(u1) != fb1.end()) fb1[u1]++;
-			else fb1.insert(make_pair(u1, 1));
+			if(fb1.find(u1) != fb1.end()) fb1[u1] += w;
+			else fb1.insert(make_pair(u1, w));
 		}
 
 		if(gr.get_vertex_info(u2).lpos == h2.pos)
 		{
-			if(fb2.find(u2) != fb2.end()) fb2[u2]++;
-			else fb2.insert(make_pair(u2, 1));
+			if(fb2.find(u2) != fb2.end()) fb2[u2] += w;
+			else fb2.insert(make_pair(u2, w));
 		}
 	}
 
@@ -1368,8 +1369,8 @@ int catch_false_boundaries(splice_graph &gr, bundle_base &bb, const parameters &
 		//printf("%s: u1 = %d, %d-%d, u2 = %d, %d-%d, h1.rpos = %d, h2.lpos = %d\n", h1.qname.c_str(), u1, v1.lpos, v1.rpos, u2, v2.lpos, v2.rpos, h1.rpos, h2.pos);
 
 		PI p(u1, u2);
-		if(fb.find(p) != fb.end()) fb[p]++;
-		else fb.insert(make_pair(p, 1));
+		if(fb.find(p) != fb.end()) fb[p] += bb.fcounts[i];
+		else fb.insert(make_pair(p, bb.fcounts[i]));
 	}
 
 	for(auto &x : fb)
@@ -5,6 +5,7 @@ See LICENSE for licensing.
 */
 
 #include <cstring>
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <sstream>
@@ -14,60 +15,75 @@ See LICENSE for licensing.
 #include "util.h"
 #include "constants.h"
 
-hit& hit::operator=(const hit &h)
+// FNV-1a, wide enough to tell reads of a bundle apart
+static int64_t qname_hash(const char *s)
 {
-	bam1_core_t::operator=(h);
-	hid = h.hid;
-	rpos = h.rpos;
-	qname = h.qname;
-	strand = h.strand;
-	//spos = h.spos;
-	xs = h.xs;
-	ts = h.ts;
-	hi = h.hi;
-	nm = h.nm;
-	nh = h.nh;
-	return *this;
+	uint64_t h = 14695981039346656037ULL;
+	for(; *s != '\0'; s++)
+	{
+		h ^= (uint8_t)(*s);
+		h *= 1099511628211ULL;
+	}
+	return (int64_t)(h);
 }
 
-hit::hit(const hit &h)
-	:bam1_core_t(h)
+// cigar in the text form of the MC tag
+static string cigar_string(const uint32_t *cigar, int n)
 {
-	hid = h.hid;
-	rpos = h.rpos;
-	qname = h.qname;
-	strand = h.strand;
-	//spos = h.spos;
-	xs = h.xs;
-	ts = h.ts;
-	hi = h.hi;
-	nm = h.nm;
-	nh = h.nh;
+	string s;
+	for(int k = 0; k < n; k++)
+	{
+		s.append(to_string(bam_cigar_oplen(cigar[k])));
+		s.push_back(BAM_CIGAR_STR[bam_cigar_op(cigar[k])]);
+	}
+	return s;
 }
 
-hit::~hit()
+hit::hit()
 {
+	tid = pos = mtid = mpos = isize = 0;
+	flag = l_qname = 0;
+	l_extranul = qual = 0;
+	hid = -1;
+	rpos = 0;
+	nh = hi = -1;
+	nm = 0;
+	strand = xs = ts = '.';
+	qhash = 0;
+	qoff = -1;
+	weight = 1;
 }
 
 hit::hit(bam1_t *b, int id)
-	:bam1_core_t(b->core), hid(id)
+	:hid(id)
 {
-	// fetch query name
-	char buf[1024];
-	char *qs = bam_get_qname(b);
-	int l = strlen(qs);
-	memcpy(buf, qs, l);
-	buf[l] = '\0';
-	qname = string(buf);
+	const bam1_core_t &p = b->core;
+	tid = p.tid;
+	pos = p.pos;
+	mtid = p.mtid;
+	mpos = p.mpos;
+	isize = p.isize;
+	flag = p.flag;
+	l_qname = p.l_qname;
+	l_extranul = p.l_extranul;
+	qual = p.qual;
+
+	nh = hi = -1;
+	nm = 0;
+	strand = xs = ts = '.';
+	qhash = qname_hash(bam_get_qname(b));
+	qoff = -1;
+	weight = 1;
 
 	// compute rpos
-	rpos = pos + (int32_t)bam_cigar2rlen(n_cigar, bam_get_cigar(b));
+	rpos = pos + (int32_t)bam_cigar2rlen(p.n_cigar, bam_get_cigar(b));
 }
 
 vector<int32_t> hit::extract_splices(bam1_t *b) const
 {
 	vector<int32_t> spos;
 	uint32_t *cigar = bam_get_cigar(b);
+	int n_cigar = b->core.n_cigar;
 	int32_t p = pos;
 	int32_t q = 0;
     for(int k = 0; k < n_cigar; k++)
@@ -130,6 +146,85 @@ int hit::set_tags(bam1_t *b)
 	return 0;
 }
 
+int hit::write(ostream &os) const
+{
+	write_binary(os, tid);
+	write_binary(os, pos);
+	write_binary(os, mtid);
+	write_binary(os, mpos);
+	write_binary(os, isize);
+	write_binary(os, flag);
+	write_binary(os, l_qname);
+	write_binary(os, l_extranul);
+	write_binary(os, qual);
+	write_binary(os, hid);
+	write_binary(os, rpos);
+	write_binary(os, nh);
+	write_binary(os, hi);
+	write_binary(os, nm);
+	write_binary(os, strand);
+	write_binary(os, xs);
+	write_binary(os, ts);
+	write_binary(os, qhash);
+	write_binary(os, qoff);
+	write_binary(os, weight);
+	return 0;
+}
+
+int hit::read(istream &is)
+{
+	read_binary(is, tid);
+	read_binary(is, pos);
+	read_binary(is, mtid);
+	read_binary(is, mpos);
+	read_binary(is, isize);
+	read_binary(is, flag);
+	read_binary(is, l_qname);
+	read_binary(is, l_extranul);
+	read_binary(is, qual);
+	read_binary(is, hid);
+	read_binary(is, rpos);
+	read_binary(is, nh);
+	read_binary(is, hi);
+	read_binary(is, nm);
+	read_binary(is, strand);
+	read_binary(is, xs);
+	read_binary(is, ts);
+	read_binary(is, qhash);
+	read_binary(is, qoff);
+	read_binary(is, weight);
+	return 0;
+}
+
+// shared by both mates of a template, used in place of the name
+// hash when identical alignments of different reads are collapsed;
+// with the MC tag the cigars of both mates are part of it, so that
+// templates at the same coordinates but with other splices stay apart
+int64_t hit::get_pair_hash(bam1_t *b) const
+{
+	uint64_t c1 = 0, c2 = 0;
+	uint8_t *p = bam_aux_get(b, "MC");
+	if(p && (*p) == 'Z')
+	{
+		c1 = (uint64_t)qname_hash(cigar_string(bam_get_cigar(b), b->core.n_cigar).c_str());
+		c2 = (uint64_t)qname_hash(bam_aux2Z(p));
+		if(c1 > c2) swap(c1, c2);
+	}
+
+	int32_t v[4] = {tid, pos < mpos ? pos : mpos, pos < mpos ? mpos : pos, isize < 0 ? 0 - isize : isize};
+	uint64_t h = 14695981039346656037ULL;
+	for(int i = 0; i < 4; i++)
+	{
+		h ^= (uint32_t)v[i];
+		h *= 1099511628211ULL;
+	}
+	h ^= c1;
+	h *= 1099511628211ULL;
+	h ^= c2;
+	h *= 1099511628211ULL;
+	return (int64_t)(h);
+}
+
 bool hit::get_concordance() const
 {
 	if((flag & 0x10) <= 0 && (flag & 0x20) >= 1 && (flag & 0x40) >= 1 && (flag & 0x80) <= 0) return true;		// F1R2
@@ -176,8 +271,8 @@ int hit::set_strand(int libtype)
 
 bool hit::operator<(const hit &h) const
 {
-	if(qname < h.qname) return true;
-	if(qname > h.qname) return false;
+	if(qhash < h.qhash) return true;
+	if(qhash > h.qhash) return false;
 	if(hi != -1 && h.hi != -1 && hi < h.hi) return true;
 	if(hi != -1 && h.hi != -1 && hi > h.hi) return false;
 	return (pos < h.pos);
@@ -186,8 +281,8 @@ bool hit::operator<(const hit &h) const
 int hit::print() const
 {
 	// print basic information
-	printf("Hit %s: tid = %d, hid = %d, [%d-%d), mpos = %d, flag = %d, quality = %d, strand = %c, xs = %c, ts = %c, isize = %d, hi = %d\n", 
-			qname.c_str(), tid, hid, pos, rpos, mpos, flag, qual, strand, xs, ts, isize, hi);
+	printf("Hit %016llx: tid = %d, hid = %d, [%d-%d), mpos = %d, flag = %d, quality = %d, strand = %c, xs = %c, ts = %c, isize = %d, hi = %d\n", 
+			(unsigned long long)(qhash), tid, hid, pos, rpos, mpos, flag, qual, strand, xs, ts, isize, hi);
 
 	return 0;
 
@@ -206,7 +301,13 @@ int hit::print() const
 
 size_t hit::get_qhash() const
 {
-	return string_hash(qname);
+	return (size_t)(qhash);
+}
+
+int hit::get_qlen() const
+{
+	// l_qname counts the terminating and extra NULs
+	return l_qname - l_extranul - 1;
 }
 
 /*
@@ -9,6 +9,7 @@ See LICENSE for licensing.
 
 #include <string>
 #include <vector>
+#include <iostream>
 
 #include "htslib/sam.h"
 
@@ -63,31 +64,50 @@ typedef struct {
  4. seq is nybble-encoded according to bam_nt16_table.
  */
 
-class hit: public bam1_core_t
+// plain record without heap members or virtual functions, so that
+// hits of a bundle live in one contiguous block freed in bulk;
+// the query name is kept as a hash, and its text only in the name
+// arena of the bundle when it is needed (see bundle_base::qnames);
+// of the core of a record only the fields used for pairing and for
+// writing bridged reads are kept, for 72 bytes per hit on LP64
+class hit
 {
 public:
+	hit();
 	hit(bam1_t *b, int id);
-	hit(const hit &h);
-	virtual ~hit();
-	virtual bool operator<(const hit &h) const;
-	virtual hit& operator=(const hit &h);
+	bool operator<(const hit &h) const;
 
 public:
+	int32_t tid;							// chromosome ID, as in bam1_core_t
+	int32_t pos;							// 0-based leftmost coordinate
+	int32_t mtid;							// chromosome ID of the mate
+	int32_t mpos;							// 0-based leftmost coordinate of the mate
+	int32_t isize;							// insert size
 	int hid;								// unique id for this hit, < 0 means removed
 	int32_t rpos;							// right position mapped to reference [pos, rpos)
 	int32_t nh;								// NH aux in sam
 	int32_t hi;								// HI aux in sam
 	int32_t nm;								// NM aux in sam
+	int64_t qhash;							// 64-bit hash of query name
+	int32_t qoff;							// offset of query name in the arena of its bundle, -1 if not kept
+	int32_t weight;							// number of identical alignments collapsed into this hit
+	uint16_t flag;							// bitwise flag
+	uint16_t l_qname;						// length of the query name with its NULs
+	uint8_t l_extranul;						// extra NULs after the query name
+	uint8_t qual;							// mapping quality
 	char strand;							// strandness
 	char xs;								// XS aux in sam
 	char ts;								// ts tag used in minimap2
-	string qname;							// query names
 
 public:
 	int set_tags(bam1_t *b);
+	int write(ostream &os) const;
+	int read(istream &is);
 	int set_strand(int lib_type);
 	int print() const;
 	size_t get_qhash() const;
+	int64_t get_pair_hash(bam1_t *b) const;
+	int get_qlen() const;
 	bool get_concordance() const;
 	vector<int32_t> extract_splices(bam1_t *b) const;
 	//int get_aligned_intervals(vector<int64_t> &v) const;
@@ -6,6 +6,8 @@ See LICENSE for licensing.
 
 #include "hit_core.h"
 
+#include <cstring>
+
 hit_core::hit_core(const hit_core &h)
 	:bam1_core_t(h)
 {
@@ -16,11 +18,22 @@ hit_core::hit_core(const hit_core &h)
 	xs = h.xs;
 }
 
-hit_core::hit_core(const hit &h)
-	:bam1_core_t(h)
+hit_core::hit_core(const hit &h, const string &q)
 {
+	// hits keep only the core fields used to build bridged reads
+	memset((bam1_core_t*)(this), 0, sizeof(bam1_core_t));
+	tid = h.tid;
+	pos = h.pos;
+	mtid = h.mtid;
+	mpos = h.mpos;
+	isize = h.isize;
+	flag = h.flag;
+	l_qname = h.l_qname;
+	l_extranul = h.l_extranul;
+	qual = h.qual;
+
 	rpos = h.rpos;
-	qname = h.qname;
+	qname = q;
 	hi = h.hi;
 	nh = h.nh;
 	xs = h.xs;
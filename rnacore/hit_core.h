@@ -44,7 +44,7 @@ typedef struct {
 class hit_core: public bam1_core_t
 {
 public:
-	hit_core(const hit &h);
+	hit_core(const hit &h, const string &qname);
 	hit_core(const hit_core &h);
 
 public:
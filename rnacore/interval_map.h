@@ -12,6 +12,7 @@ See LICENSE for licensing.
 #include "boost/icl/split_interval_map.hpp"
 
 #include <vector>
+#include <iostream>
 
 using namespace boost;
 using namespace std;
@@ -0,0 +1,67 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+mutex mapped_file::lock;
+map<string, std::weak_ptr<mapped_file>> mapped_file::files;
+
+mapped_file::mapped_file()
+{
+	data = NULL;
+	size = 0;
+}
+
+mapped_file::~mapped_file()
+{
+	if(data != NULL && size >= 1) munmap((void*)(data), size);
+}
+
+std::shared_ptr<mapped_file> mapped_file::open(const string &file)
+{
+	lock_guard<mutex> lk(lock);
+	auto it = files.find(file);
+	if(it != files.end())
+	{
+		std::shared_ptr<mapped_file> p = it->second.lock();
+		if(p != NULL) return p;
+	}
+
+	int fd = ::open(file.c_str(), O_RDONLY);
+	if(fd < 0) return NULL;
+
+	struct stat st;
+	if(fstat(fd, &st) != 0)
+	{
+		::close(fd);
+		return NULL;
+	}
+
+	std::shared_ptr<mapped_file> p(new mapped_file());
+	p->size = st.st_size;
+	if(p->size >= 1)
+	{
+		void *m = mmap(NULL, p->size, PROT_READ, MAP_SHARED, fd, 0);
+		if(m == MAP_FAILED) p->size = 0;
+		else p->data = (const char*)(m);
+	}
+	::close(fd);
+
+	if(p->data == NULL && st.st_size >= 1) return NULL;
+	files[file] = p;
+	return p;
+}
+
+memory_buffer::memory_buffer(const char *data, size_t size)
+{
+	char *p = const_cast<char*>(data);
+	setg(p, p, p + size);
+}
@@ -0,0 +1,45 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+
+using namespace std;
+
+// read-only memory mapping of a file; mappings are shared
+// by all readers of the same file and unmapped with the last
+class mapped_file
+{
+public:
+	~mapped_file();
+
+public:
+	const char *data;
+	size_t size;
+
+public:
+	static std::shared_ptr<mapped_file> open(const string &file);
+
+private:
+	mapped_file();
+	static mutex lock;
+	static map<string, std::weak_ptr<mapped_file>> files;
+};
+
+// stream buffer over a range of memory, to read records in place
+class memory_buffer : public streambuf
+{
+public:
+	memory_buffer(const char *data, size_t size);
+};
+
+#endif
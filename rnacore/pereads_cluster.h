@@ -8,6 +8,7 @@ See LICENSE for licensing.
 #define __PEREADS_CLUSTER_H__
 
 #include "hit.h"
+#include "hit_core.h"
 #include "constants.h"
 #include <cstdint>
 #include <vector>
@@ -30,8 +31,8 @@ public:
 	vector<int32_t> bounds;			// lpos1, rpos1, lpos2, rpos2
 	vector<int32_t> extend;			// lexon1, rexon1, lexon2, rexon2
 	vector<int> frlist;				// fragments in this cluster
-	vector<hit> hits1;				// hits in this cluster (when bridged reads needes to be reported)
-	vector<hit> hits2;				// hits in this cluster (when bridged reads needes to be reported)
+	vector<hit_core> hits1;			// hits in this cluster (when bridged reads needes to be reported)
+	vector<hit_core> hits2;			// hits in this cluster (when bridged reads needes to be reported)
 	int count;						// number of such reads in this cluster
 
 public:
@@ -0,0 +1,100 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#include "position_index.h"
+#include <algorithm>
+#include <cassert>
+
+int position_index::clear()
+{
+	keys.clear();
+	values.clear();
+	return 0;
+}
+
+int position_index::add(int32_t p, int v)
+{
+	keys.push_back(p);
+	values.push_back(v);
+	return 0;
+}
+
+int position_index::build()
+{
+	assert(keys.size() == values.size());
+
+	bool sorted = true;
+	for(int i = 1; i < keys.size(); i++)
+	{
+		if(keys[i - 1] < keys[i]) continue;
+		sorted = false;
+		break;
+	}
+	if(sorted == true) return 0;
+
+	vector< pair<int32_t, int> > kv(keys.size());
+	for(int i = 0; i < keys.size(); i++) kv[i] = pair<int32_t, int>(keys[i], i);
+	stable_sort(kv.begin(), kv.end(), [](const pair<int32_t, int> &x, const pair<int32_t, int> &y){ return x.first < y.first; });
+
+	vector<int> vv;
+	keys.clear();
+	for(int i = 0; i < kv.size(); i++)
+	{
+		if(i >= 1 && kv[i].first == kv[i - 1].first) continue;
+		keys.push_back(kv[i].first);
+		vv.push_back(values[kv[i].second]);
+	}
+	values = vv;
+	return 0;
+}
+
+size_t position_index::size() const
+{
+	return keys.size();
+}
+
+int position_index::find(int32_t p) const
+{
+	vector<int32_t>::const_iterator it = lower_bound(keys.begin(), keys.end(), p);
+	if(it == keys.end() || *it != p) return -1;
+	return values[it - keys.begin()];
+}
+
+bool position_index::contains(int32_t p) const
+{
+	return (find(p) >= 0);
+}
+
+int position_index::operator[](int32_t p) const
+{
+	return find(p);
+}
+
+int position_index::find(const vector<int32_t> &p, vector<int> &v) const
+{
+	// gallop from the previous answer, which makes one linear
+	// pass for non-decreasing positions and O(log) steps otherwise
+	v.assign(p.size(), -1);
+	int n = keys.size();
+	int j = 0;
+	for(int i = 0; i < p.size(); i++)
+	{
+		// find the first key j with keys[j] >= p[i]
+		int a = j, b = j;
+		if(j < n && keys[j] < p[i]) for(int s = 1; ; s *= 2)
+		{
+			a = b + 1;
+			b = j + s;
+			if(b >= n || keys[b] >= p[i]) break;
+		}
+		else if(j >= 1 && keys[j - 1] >= p[i]) a = 0;
+		if(b > n) b = n;
+		j = lower_bound(keys.begin() + a, keys.begin() + b, p[i]) - keys.begin();
+
+		if(j < n && keys[j] == p[i]) v[i] = values[j];
+	}
+	return 0;
+}
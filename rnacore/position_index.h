@@ -0,0 +1,40 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#ifndef __POSITION_INDEX_H__
+#define __POSITION_INDEX_H__
+
+#include <vector>
+#include <stdint.h>
+
+using namespace std;
+
+// map from genomic position to vertex kept in two parallel
+// sorted vectors; positions are appended with add and then
+// sorted once by build (the first vertex added for a position wins)
+class position_index
+{
+public:
+	vector<int32_t> keys;		// sorted positions
+	vector<int> values;			// vertex of each position
+
+public:
+	int clear();
+	int add(int32_t p, int v);
+	int build();
+	size_t size() const;
+
+	// vertex at position p, or -1 if p is not present
+	int find(int32_t p) const;
+	bool contains(int32_t p) const;
+	int operator[](int32_t p) const;
+
+	// locate a list of positions in one merge-style sweep;
+	// fastest when p is non-decreasing (e.g., hits in order)
+	int find(const vector<int32_t> &p, vector<int> &v) const;
+};
+
+#endif
@@ -19,7 +19,7 @@ region::region(int32_t _lpos, int32_t _rpos, int _ltype, int _rtype)
 } 
 */
 
-region::region(int32_t _lpos, int32_t _rpos, int _ltype, int _rtype, const split_interval_map *_mmap, const split_interval_map *_imap, const parameters &c, const sample_profile &s)
+region::region(int32_t _lpos, int32_t _rpos, int _ltype, int _rtype, const coverage_map *_mmap, const coverage_map *_imap, const parameters &c, const sample_profile &s)
 	:lpos(_lpos), rpos(_rpos), mmap(_mmap), imap(_imap), ltype(_ltype), rtype(_rtype), cfg(c), sp(s)
 {
 	build_join_interval_map();
@@ -35,12 +35,12 @@ int region::build_join_interval_map()
 {
 	jmap.clear();
 
-	PSIMI pei = locate_boundary_iterators(*mmap, lpos, rpos);
-	SIMI lit = pei.first, rit = pei.second;
+	PCMI pei = locate_boundary_iterators(*mmap, lpos, rpos);
+	CMI lit = pei.first, rit = pei.second;
 
 	if(lit == mmap->end() || rit == mmap->end()) return 0;
 
-	SIMI it = lit;
+	CMI it = lit;
 	while(true)
 	{
 		//if(it->second >= 2) 
@@ -93,8 +93,8 @@ bool region::empty_subregion(int32_t p1, int32_t p2)
 	//printf(" region = [%d, %d), subregion [%d, %d), length = %d\n", lpos, rpos, p1, p2, p2 - p1);
 	if(p2 - p1 < cfg.min_subregion_length) return true;
 
-	PSIMI pei = locate_boundary_iterators(*mmap, p1, p2);
-	SIMI it1 = pei.first, it2 = pei.second;
+	PCMI pei = locate_boundary_iterators(*mmap, p1, p2);
+	CMI it1 = pei.first, it2 = pei.second;
 	if(it1 == mmap->end() || it2 == mmap->end()) return true;
 
 	int32_t sum = compute_sum_overlap(*mmap, it1, it2);
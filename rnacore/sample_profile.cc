@@ -7,9 +7,19 @@ See LICENSE for licensing.
 #include "sample_profile.h"
 #include "htslib/bgzf.h"
 #include "constants.h"
+#include "util.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <climits>
+#include <sys/stat.h>
+
+#define PROFILE_MAGIC 0x46505341
+#define PROFILE_VERSION 1
 
-mutex sample_profile::bam_lock;
 mutex sample_profile::gtf_lock;
+mutex sample_profile::bridged_lock;
 
 sample_profile::sample_profile(int id)
 {
@@ -17,113 +27,238 @@ sample_profile::sample_profile(int id)
 	sfn = NULL;
 	hdr = NULL;
 	bridged_bam = NULL;
+	bridged_bam_threads = 1;
+	bridged_bam_sorted = false;
+	bridged_bam_buffer = 0;
+	decode_pool = NULL;
 	individual_gtf = NULL;
+	idx = NULL;
 	data_type = DEFAULT;
 	insertsize_low = 80;
 	insertsize_high = 500;
 	insertsize_median = 250;
 	library_type = UNSTRANDED;
 	bam_with_xs = 0;
+	insertsize_ave = 0;
+	insertsize_std = 0;
+	file_size = -1;
+	file_mtime = -1;
+	file_checksum = 0;
 }
 
-int sample_profile::load_profile(const string &dir)
+// FNV-1a of the header text
+static uint64_t header_checksum(const bam_hdr_t *h)
 {
-	char file[10240];
-	sprintf(file, "%s/%d.profile", dir.c_str(), sample_id);
-	ifstream fin(file);
-	if(fin.fail())
+	uint64_t x = 14695981039346656037ULL;
+	if(h == NULL || h->text == NULL) return x;
+	for(uint32_t i = 0; i < h->l_text; i++)
 	{
-		printf("cannot open profile to read: %s\n", file);
-		return 0;
+		x ^= (uint8_t)(h->text[i]);
+		x *= 1099511628211ULL;
 	}
+	return x;
+}
+
+int sample_profile::read_identity()
+{
+	char buf[PATH_MAX];
+	if(realpath(align_file.c_str(), buf) != NULL) file_path = string(buf);
+	else file_path = align_file;
 
-	char line[10240];
-	while(fin.getline(line, 10240, '\n'))
+	struct stat st;
+	file_size = -1;
+	file_mtime = -1;
+	if(stat(align_file.c_str(), &st) == 0)
 	{
-		if(string(line) == "") continue;
-		stringstream sstr(line);
-		char key[10240];
-		sstr >> key;
-		
-		if(string(key) == "library_type") sstr >> library_type;
-		if(string(key) == "bam_with_xs") sstr >> bam_with_xs;
-		if(string(key) == "insertsize_low") sstr >> insertsize_low;
-		if(string(key) == "insertsize_high") sstr >> insertsize_high;
-		if(string(key) == "insertsize_median") sstr >> insertsize_median;
-		if(string(key) == "insertsize_ave") sstr >> insertsize_ave;
-		if(string(key) == "insertsize_std") sstr >> insertsize_std;
+		file_size = st.st_size;
+		file_mtime = st.st_mtime;
 	}
 
-	fin.close();
+	read_align_headers();
+	file_checksum = header_checksum(hdr);
 	return 0;
 }
 
-int sample_profile::save_profile(const string &dir)
+uint64_t sample_profile::get_identity() const
+{
+	uint64_t x = 14695981039346656037ULL;
+	string key = file_path;
+	key.append((const char*)(&file_size), sizeof(file_size));
+	key.append((const char*)(&file_mtime), sizeof(file_mtime));
+	key.append((const char*)(&file_checksum), sizeof(file_checksum));
+	for(int i = 0; i < key.size(); i++)
+	{
+		x ^= (uint8_t)(key[i]);
+		x *= 1099511628211ULL;
+	}
+	return x;
+}
+
+string sample_profile::get_profile_file(const string &dir) const
 {
+	// named by the identity of the file instead of its rank in the list
 	char file[10240];
-	sprintf(file, "%s/%d.profile", dir.c_str(), sample_id);
-	ofstream fout(file);
+	sprintf(file, "%s/%016llx.profile", dir.c_str(), (unsigned long long)(get_identity()));
+	return string(file);
+}
+
+string sample_profile::get_store_file(const string &dir, int tid, int32_t lpos) const
+{
+	char file[10240];
+	sprintf(file, "%s/%016llx.%d.%d.store", dir.c_str(), (unsigned long long)(get_identity()), tid, lpos);
+	return string(file);
+}
+
+bool sample_profile::load_profile(const string &dir)
+{
+	string file = get_profile_file(dir);
+	ifstream fin(file.c_str(), ios::binary);
+	if(fin.fail()) return false;
+
+	// the identity is verified, as names may collide
+	int32_t magic = 0, version = 0, type = 0;
+	string path;
+	int64_t size = -1, mtime = -1;
+	uint64_t checksum = 0;
+	read_binary(fin, magic);
+	read_binary(fin, version);
+	read_binary_string(fin, path);
+	read_binary(fin, size);
+	read_binary(fin, mtime);
+	read_binary(fin, checksum);
+	read_binary(fin, type);
+
+	if(fin.fail() || magic != PROFILE_MAGIC || version != PROFILE_VERSION) return false;
+	if(path != file_path || size != file_size || mtime != file_mtime || checksum != file_checksum) return false;
+	if(type != data_type) return false;
+
+	int32_t lt, xs, low, high, median;
+	double ave, std;
+	vector<double> vp;
+	vector<int64_t> vr;
+	read_binary(fin, lt);
+	read_binary(fin, xs);
+	read_binary(fin, low);
+	read_binary(fin, high);
+	read_binary(fin, median);
+	read_binary(fin, ave);
+	read_binary(fin, std);
+	read_binary_vector(fin, vp);
+	read_binary_vector(fin, vr);
+	if(fin.fail()) return false;
+	fin.close();
+
+	library_type = lt;
+	bam_with_xs = xs;
+	insertsize_low = low;
+	insertsize_high = high;
+	insertsize_median = median;
+	insertsize_ave = ave;
+	insertsize_std = std;
+	insertsize_profile = std::move(vp);
+	target_reads = std::move(vr);
+	return true;
+}
+
+int sample_profile::save_profile(const string &dir)
+{
+	// written aside and renamed, so readers never see a partial profile
+	string file = get_profile_file(dir);
+	string temp = file + ".tmp";
+	ofstream fout(temp.c_str(), ios::binary);
 	if(fout.fail())
 	{
-		printf("cannot open profile to write: %s\n", file);
+		printf("cannot open profile to write: %s\n", temp.c_str());
 		return 0;
 	}
 
-	fout << "library_type" << " " << library_type << endl;
-	fout << "bam_with_xs" << " " << bam_with_xs << endl;
+	int32_t magic = PROFILE_MAGIC, version = PROFILE_VERSION, type = data_type;
+	int32_t lt = library_type, xs = bam_with_xs;
+	int32_t low = insertsize_low, high = insertsize_high, median = insertsize_median;
+	write_binary(fout, magic);
+	write_binary(fout, version);
+	write_binary_string(fout, file_path);
+	write_binary(fout, file_size);
+	write_binary(fout, file_mtime);
+	write_binary(fout, file_checksum);
+	write_binary(fout, type);
+	write_binary(fout, lt);
+	write_binary(fout, xs);
+	write_binary(fout, low);
+	write_binary(fout, high);
+	write_binary(fout, median);
+	write_binary(fout, insertsize_ave);
+	write_binary(fout, insertsize_std);
+	write_binary_vector(fout, insertsize_profile);
+	write_binary_vector(fout, target_reads);
+	fout.close();
+
+	rename(temp.c_str(), file.c_str());
+	return 0;
+}
 
-	if(data_type == PAIRED_END)
+int sample_profile::count_target_reads()
+{
+	// -1 for targets without index statistics
+	target_reads.assign(hdr == NULL ? 0 : hdr->n_targets, -1);
+	if(idx == NULL) return 0;
+	for(int i = 0; i < target_reads.size(); i++)
 	{
-		fout << "insertsize_low" << " " << insertsize_low << endl;
-		fout << "insertsize_high" << " " << insertsize_high << endl;
-		fout << "insertsize_median" << " " << insertsize_median << endl;
-		fout << "insertsize_ave" << " " << insertsize_ave << endl;
-		fout << "insertsize_std" << " " << insertsize_std << endl;
+		uint64_t mapped = 0, unmapped = 0;
+		if(hts_idx_get_stat(idx, i, &mapped, &unmapped) < 0) continue;
+		target_reads[i] = mapped;
 	}
-
-	fout.close();
 	return 0;
 }
 
 int sample_profile::read_align_headers()
 {
-	open_align_file();
-	hdr = sam_hdr_read(sfn);
-	close_align_file();
+	// the parsed header is cached and shared by all units
+	if(hdr != NULL) return 0;
+	samFile *fp = sam_open(align_file.c_str(), "r");
+	hdr = sam_hdr_read(fp);
+	sam_close(fp);
 	return 0;
 }
 
 int sample_profile::free_align_headers()
 {
-    if(hdr != NULL) bam_hdr_destroy(hdr);
+	if(hdr != NULL) bam_hdr_destroy(hdr);
+	hdr = NULL;
 	return 0;
 }
 
 int sample_profile::open_align_file()
 {
+	// records follow the header, which is parsed only once
 	sfn = sam_open(align_file.c_str(), "r");
-	hdr = sam_hdr_read(sfn);
+	bam_hdr_t *h = sam_hdr_read(sfn);
+	if(hdr == NULL) hdr = h;
+	else bam_hdr_destroy(h);
 	return 0;
 }
 
-int sample_profile::init_bridged_bam(const string &dir)
+int sample_profile::init_bridged_bam(const string &dir, int threads, bool sorted, int64_t buffer)
 {
+	// the writer (and its thread) is started by the first producer
 	char file[10240];
 	sprintf(file, "%s/%d.bam", dir.c_str(), sample_id);
-	open_align_file();
-	bridged_bam = bgzf_open(file, "w");
-	bam_hdr_write(bridged_bam, hdr);
-	close_bridged_bam();
-	close_align_file();
+	bridged_bam_file = file;
+	bridged_bam_threads = threads;
+	bridged_bam_sorted = sorted;
+	bridged_bam_buffer = buffer;
 	return 0;
 }
 
-int sample_profile::open_bridged_bam(const string &dir)
+bam_writer* sample_profile::open_bridged_bam() const
 {
-	char file[10240];
-	sprintf(file, "%s/%d.bam", dir.c_str(), sample_id);
-	bridged_bam = bgzf_open(file, "a");
-	return 0;
+	// called by bundles while bridging, after the header is cached
+	if(bridged_bam_file == "") return NULL;
+	lock_guard<mutex> lock(bridged_lock);
+	if(bridged_bam != NULL) return bridged_bam;
+	assert(hdr != NULL);
+	bridged_bam = new bam_writer(bridged_bam_file, hdr, bridged_bam_threads, bridged_bam_sorted, bridged_bam_buffer);
+	return bridged_bam;
 }
 
 int sample_profile::open_individual_gtf(const string &dir)
@@ -149,43 +284,72 @@ int sample_profile::close_individual_gtf()
 
 int sample_profile::close_bridged_bam()
 {
-	if(bridged_bam != NULL) bgzf_close(bridged_bam);
+	if(bridged_bam_file == "") return 0;
+
+	// nothing was written; leave a file with the header only
+	if(bridged_bam == NULL)
+	{
+		read_align_headers();
+		BGZF *fp = bgzf_open(bridged_bam_file.c_str(), "w");
+		if(fp == NULL) return 0;
+		bam_hdr_write(fp, hdr);
+		bgzf_close(fp);
+		return 0;
+	}
+
+	bridged_bam->close();
+	delete bridged_bam;
+	bridged_bam = NULL;
 	return 0;
 }
 
 int sample_profile::close_align_file()
 {
-    if(hdr != NULL) bam_hdr_destroy(hdr);
-    if(sfn != NULL) sam_close(sfn);
+	if(sfn != NULL) sam_close(sfn);
+	sfn = NULL;
 	return 0;
 }
 
-int sample_profile::read_index_iterators()
+bam_hdr_t* sample_profile::read_handle_header(samFile *fp)
 {
-	open_align_file();
-	hts_idx_t *idx = sam_index_load(sfn, index_file.c_str());
-
-	iters.clear();
-	for(int i = 0; i < hdr->n_targets; i++)
-	{
-		hts_itr_t *iter = sam_itr_querys(idx, hdr, hdr->target_name[i]);
-		iters.push_back(iter);
-	}
+	// BAM records are located through the index alone, while iterating
+	// SAM.gz or CRAM needs the header of the handle (fp->bam_header);
+	// names always come from the cached header
+	if(hts_get_format(fp)->format == bam) return NULL;
+	return sam_hdr_read(fp);
+}
 
-	hts_idx_destroy(idx);
-	close_align_file();
+int sample_profile::read_index()
+{
+	// the index is loaded once; iterators are created per unit
+	if(idx != NULL) return 0;
+	samFile *fp = sam_open(align_file.c_str(), "r");
+	idx = sam_index_load(fp, index_file.c_str());
+	sam_close(fp);
 	return 0;
 }
 
-int sample_profile::free_index_iterators()
+int sample_profile::free_index()
 {
-	for(int i = 0; i < iters.size(); i++)
-	{
-		hts_itr_destroy(iters[i]);
-	}
+	if(idx != NULL) hts_idx_destroy(idx);
+	idx = NULL;
 	return 0;
 }
 
+hts_itr_t* sample_profile::get_iterator(int tid, int32_t lpos, int32_t rpos) const
+{
+	if(idx == NULL) return NULL;
+	if(lpos < 0) lpos = 0;
+	return sam_itr_queryi(idx, tid, lpos, rpos);
+}
+
+string sample_profile::get_spill_file(const string &dir, int tid, int32_t lpos) const
+{
+	char file[10240];
+	sprintf(file, "%s/%d.%d.%d.bundles", dir.c_str(), sample_id, tid, lpos);
+	return string(file);
+}
+
 int sample_profile::print()
 {
 	printf("file = %s, type = %d\n", align_file.c_str(), data_type);
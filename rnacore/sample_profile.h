@@ -12,6 +12,7 @@ See LICENSE for licensing.
 #include <htslib/sam.h>
 #include <mutex>
 #include <fstream>
+#include "bam_writer.h"
 
 using namespace std;
 
@@ -25,10 +26,15 @@ public:
 	string align_file;
 	string index_file;
 	samFile *sfn;
-	bam_hdr_t *hdr;
-	BGZF *bridged_bam;
+	bam_hdr_t *hdr;						// cached header, shared by all units
+	mutable bam_writer *bridged_bam;	// started on the first write
+	string bridged_bam_file;			// empty if bridged alignments are not written
+	int bridged_bam_threads;
+	bool bridged_bam_sorted;
+	int64_t bridged_bam_buffer;
+	static mutex bridged_lock;
+	htsThreadPool *decode_pool;			// shared by all samples, not owned
 	ofstream *individual_gtf;
-	static mutex bam_lock;
 	static mutex gtf_lock;
 	int data_type;
 	int library_type;
@@ -38,23 +44,36 @@ public:
 	int insertsize_median;
 	double insertsize_ave;
 	double insertsize_std;
-	vector<double> insertsize_profile;
-	vector<hts_itr_t*> iters;
+	vector<double> insertsize_profile;		// frequency of each insert size up to insertsize_high
+	vector<int64_t> target_reads;			// mapped reads of each target, -1 if unknown
+	string file_path;						// identity of the alignment file,
+	int64_t file_size;						// which keys its cached profile
+	int64_t file_mtime;
+	uint64_t file_checksum;					// of the header text
+	hts_idx_t *idx;						// cached index, shared by all units
 
 public:
-	int load_profile(const string &dir);
+	int read_identity();
+	uint64_t get_identity() const;
+	string get_profile_file(const string &dir) const;
+	bool load_profile(const string &dir);
 	int save_profile(const string &dir);
+	int count_target_reads();
 	int open_align_file();
-	int open_bridged_bam(const string &dir);
-	int init_bridged_bam(const string &dir);
+	int init_bridged_bam(const string &dir, int threads, bool sorted, int64_t buffer);
+	bam_writer *open_bridged_bam() const;
 	int open_individual_gtf(const string &dir);
 	int read_align_headers();
-	int read_index_iterators();
+	static bam_hdr_t *read_handle_header(samFile *fp);
+	int read_index();
 	int free_align_headers();
-	int free_index_iterators();
+	int free_index();
 	int close_individual_gtf();
 	int close_bridged_bam();
 	int close_align_file();
+	hts_itr_t *get_iterator(int tid, int32_t lpos, int32_t rpos) const;
+	string get_spill_file(const string &dir, int tid, int32_t lpos) const;
+	string get_store_file(const string &dir, int tid, int32_t lpos) const;
 	int print();
 };
 
@@ -51,8 +51,6 @@ int splice_graph::copy(const splice_graph &gr, MEE &x2y, MEE &y2x)
 		set_edge_info(e, gr.get_edge_info(*it));
 
 		assert(e != NULL);
-		assert(ewrt.find(e) != ewrt.end());
-		assert(einf.find(e) != einf.end());
 		assert(x2y.find(*it) == x2y.end());
 		assert(y2x.find(e) == y2x.end());
 
@@ -92,16 +90,14 @@ vertex_info splice_graph::get_vertex_info(int v) const
 
 double splice_graph::get_edge_weight(edge_base *e) const
 {
-	MED::const_iterator it = ewrt.find(e);
-	assert(it != ewrt.end());
-	return it->second;
+	assert(e->index() >= 0 && e->index() < ewrt.size());
+	return ewrt[e->index()];
 }
 
 edge_info splice_graph::get_edge_info(edge_base *e) const
 {
-	MEIF::const_iterator it = einf.find(e);
-	assert(it != einf.end());
-	return it->second;
+	assert(e->index() >= 0 && e->index() < einf.size());
+	return einf[e->index()];
 }
 
 int splice_graph::set_vertex_weight(int v, double w) 
@@ -122,21 +118,28 @@ int splice_graph::set_vertex_info(int v, const vertex_info &vi)
 
 int splice_graph::set_edge_weight(edge_base* e, double w) 
 {
-	if(ewrt.find(e) != ewrt.end()) ewrt[e] = w;
-	else ewrt.insert(PED(e, w));
+	assert(e->index() >= 0 && e->index() < num_edge_indices());
+	if(ewrt.size() != num_edge_indices()) ewrt.resize(num_edge_indices(), 0);
+	ewrt[e->index()] = w;
 	return 0;
 }
 
 int splice_graph::set_edge_info(edge_base* e, const edge_info &ei) 
 {
-	if(einf.find(e) != einf.end()) einf[e] = ei;
-	else einf.insert(PEIF(e, ei));
+	assert(e->index() >= 0 && e->index() < num_edge_indices());
+	if(einf.size() != num_edge_indices()) einf.resize(num_edge_indices());
+	einf[e->index()] = ei;
 	return 0;
 }
 
 MED splice_graph::get_edge_weights() const
 {
-	return ewrt;
+	MED med;
+	for(edge_iterator it = se.begin(); it != se.end(); it++)
+	{
+		med.insert(PED(*it, get_edge_weight(*it)));
+	}
+	return med;
 }
 
 vector<double> splice_graph::get_vertex_weights() const
@@ -146,7 +149,10 @@ vector<double> splice_graph::get_vertex_weights() const
 
 int splice_graph::set_edge_weights(const MED &med)
 {
-	ewrt = med;
+	for(MED::const_iterator it = med.begin(); it != med.end(); it++)
+	{
+		set_edge_weight(it->first, it->second);
+	}
 	return 0;
 }
 
@@ -484,9 +490,9 @@ int splice_graph::simulate(int nv, int ne, int mw)
 		if(p.second == true) continue;
 
 		edge_descriptor e = add_edge(s, t);
-		ewrt.insert(PED(e, f));
-		einf.insert(PEIF(e, edge_info()));
-		if(ewrt.size() >= ne) break;
+		set_edge_weight(e, f);
+		set_edge_info(e, edge_info());
+		if(num_edges() >= ne) break;
 	}
 
 	assert(in_degree(0) == 0);
@@ -500,22 +506,23 @@ int splice_graph::simulate(int nv, int ne, int mw)
 		if(w <= 0) break;
 		for(int i = 0; i < v.size(); i++)
 		{
-			ewrt[v[i]] -= w;
+			ewrt[v[i]->index()] -= w;
 			if(med.find(v[i]) == med.end()) med.insert(PED(v[i], w));
 			else med[v[i]] += w;
 		}
 	}
 
-	for(MED::iterator it = ewrt.begin(); it != ewrt.end(); it++)
+	VE ve;
+	for(edge_iterator it = se.begin(); it != se.end(); it++)
 	{
-		if(med.find(it->first) == med.end()) remove_edge(it->first);
+		if(med.find(*it) == med.end()) ve.push_back(*it);
 	}
+	for(int i = 0; i < ve.size(); i++) remove_edge(ve[i]);
 
-	ewrt = med;
-	einf.clear();
-	for(MED::iterator it = ewrt.begin(); it != ewrt.end(); it++)
+	for(MED::iterator it = med.begin(); it != med.end(); it++)
 	{
-		einf.insert(PEIF(it->first, edge_info()));
+		set_edge_weight(it->first, it->second);
+		set_edge_info(it->first, edge_info());
 	}
 
 	edge_iterator it1, it2;
@@ -525,12 +532,12 @@ int splice_graph::simulate(int nv, int ne, int mw)
 		int wx = 0;
 		for(pei = in_edges(i), it1 = pei.first, it2 = pei.second; it1 != it2; it1++)
 		{
-			wx += (int)(ewrt[*it1]);
+			wx += (int)(get_edge_weight(*it1));
 		}
 		int wy = 0;
 		for(pei = out_edges(i), it1 = pei.first, it2 = pei.second; it1 != it2; it1++)
 		{
-			wy += (int)(ewrt[*it1]);
+			wy += (int)(get_edge_weight(*it1));
 		}
 
 		if(i == 0) assert(wx == 0);
@@ -976,11 +983,7 @@ int splice_graph::locate(int v)
 
 int splice_graph::round_weights()
 {
-	MED m = ewrt;
-	for(MED::iterator it = m.begin(); it != m.end(); it++)
-	{
-		it->second = 0.0;
-	}
+	vector<double> m(ewrt.size(), 0.0);
 
 	while(true)
 	{
@@ -1010,9 +1013,10 @@ int splice_graph::round_weights()
 		
 		for(int i = 0; i < v.size(); i++)
 		{
-			m[v[i]] += ww;
-			ewrt[v[i]] -= ww;
-			if(ewrt[v[i]] <= 0) ewrt[v[i]] = 0;
+			int k = v[i]->index();
+			m[k] += ww;
+			ewrt[k] -= ww;
+			if(ewrt[k] <= 0) ewrt[k] = 0;
 		}
 	}
 
@@ -1022,7 +1026,7 @@ int splice_graph::round_weights()
 	PEEI pei;
 	for(pei = out_edges(0), it1 = pei.first, it2 = pei.second; it1 != it2; it1++)
 	{
-		double w = ewrt[*it1];
+		double w = get_edge_weight(*it1);
 		vwrt[0] += w;
 	}
 
@@ -1030,7 +1034,7 @@ int splice_graph::round_weights()
 	{
 		for(pei = in_edges(i), it1 = pei.first, it2 = pei.second; it1 != it2; it1++)
 		{
-			double w = ewrt[*it1];
+			double w = get_edge_weight(*it1);
 			vwrt[i] += w;
 		}
 	}
@@ -1076,23 +1080,23 @@ int splice_graph::build_vertex_index()
 	int n = num_vertices() - 1;
 	for(int i = 0; i <= n; i++)
 	{
-		const vertex_info &v = get_vertex_info(i);
-		if(i != 0) lindex.insert(pair<int32_t, int>(v.lpos, i));
-		if(i != n) rindex.insert(pair<int32_t, int>(v.rpos, i));
+		const vertex_info &v = vinf[i];
+		if(i != 0) lindex.add(v.lpos, i);
+		if(i != n) rindex.add(v.rpos, i);
 	}
+	lindex.build();
+	rindex.build();
 	return 0;
 }
 
 int splice_graph::locate_lbound(int32_t p)
 {
-	if(lindex.find(p) == lindex.end()) return -1;
-	else return lindex[p];
+	return lindex.find(p);
 }
 
 int splice_graph::locate_rbound(int32_t p)
 {
-	if(rindex.find(p) == rindex.end()) return -1;
-	else return rindex[p];
+	return rindex.find(p);
 }
 
 int splice_graph::locate_vertex(int32_t p)
@@ -1102,13 +1106,49 @@ int splice_graph::locate_vertex(int32_t p)
 
 int splice_graph::locate_vertex(int32_t p, int a, int b)
 {
-	if(a >= b) return -1;
-	int m = (a + b) / 2;
-	assert(m >= 0 && m < num_vertices());
-	const vertex_info &v = get_vertex_info(m);
-	if(p >= v.lpos && p < v.rpos) return m;
-	if(p < v.lpos) return locate_vertex(p, a, m);
-	return locate_vertex(p, m + 1, b);
+	while(a < b)
+	{
+		int m = (a + b) / 2;
+		assert(m >= 0 && m < num_vertices());
+		const vertex_info &v = vinf[m];
+		if(p >= v.lpos && p < v.rpos) return m;
+		if(p < v.lpos) b = m;
+		else a = m + 1;
+	}
+	return -1;
+}
+
+int splice_graph::locate_vertices(const vector<int32_t> &p, vector<int> &v)
+{
+	// sweep over the vertices with a cursor that gallops from the
+	// previous answer; one linear pass for non-decreasing positions
+	v.assign(p.size(), -1);
+	int n = num_vertices();
+	int j = 0;
+	for(int i = 0; i < p.size(); i++)
+	{
+		// find the first vertex j with rpos > p[i]
+		int a = j, b = j;
+		if(j < n && vinf[j].rpos <= p[i]) for(int s = 1; ; s *= 2)
+		{
+			a = b + 1;
+			b = j + s;
+			if(b >= n || vinf[b].rpos > p[i]) break;
+		}
+		else if(j >= 1 && vinf[j - 1].rpos > p[i]) a = 0;
+		if(b > n) b = n;
+		while(a < b)
+		{
+			int m = (a + b) / 2;
+			if(vinf[m].rpos <= p[i]) a = m + 1;
+			else b = m;
+		}
+		j = a;
+
+		if(j >= n) continue;
+		if(p[i] >= vinf[j].lpos && p[i] < vinf[j].rpos) v[i] = j;
+	}
+	return 0;
 }
 
 int splice_graph::draw(const string &file, const MIS &mis, const MES &mes, double len, const vector<int> &tp, bool footer)
@@ -11,6 +11,7 @@ See LICENSE for licensing.
 #include "vertex_info.h"
 #include "edge_info.h"
 #include "gene.h"
+#include "position_index.h"
 
 #include <map>
 #include <cassert>
@@ -36,11 +37,11 @@ public:
 
 	vector<double> vwrt;
 	vector<vertex_info> vinf;
-	MED ewrt;
-	MEIF einf;
+	vector<double> ewrt;			// edge weights by edge index
+	vector<edge_info> einf;			// edge infos by edge index
 
-	map<int32_t, int> lindex;
-	map<int32_t, int> rindex;
+	position_index lindex;			// left boundary to vertex
+	position_index rindex;			// right boundary to vertex
 
 public:
 	// get and set properties
@@ -113,6 +114,7 @@ public:
 	int build_vertex_index();
 	int locate_vertex(int32_t p, int a, int b);
 	int locate_vertex(int32_t p);
+	int locate_vertices(const vector<int32_t> &p, vector<int> &v);
 	int locate_lbound(int32_t p);
 	int locate_rbound(int32_t p);
 	int32_t get_total_length_of_vertices(const vector<int>& v) const;
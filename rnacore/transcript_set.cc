@@ -7,6 +7,7 @@ See LICENSE for licensing.
 #include <cassert>
 #include "transcript_set.h"
 #include "constants.h"
+#include "util.h"
 //#include <boost/asio/post.hpp>
 //#include <boost/asio/thread_pool.hpp>
 
@@ -46,6 +47,38 @@ int trans_item::merge(const trans_item &ti, int mode)
 	return 0;
 }
 
+int trans_item::write(ostream &os) const
+{
+	trst.save(os);
+	write_binary(os, count);
+	int64_t n = samples.size();
+	write_binary(os, n);
+	for(auto &x : samples)
+	{
+		write_binary(os, x.first);
+		write_binary(os, x.second);
+	}
+	return 0;
+}
+
+int trans_item::read(istream &is)
+{
+	trst.load(is);
+	read_binary(is, count);
+	int64_t n = 0;
+	read_binary(is, n);
+	samples.clear();
+	for(int64_t i = 0; i < n; i++)
+	{
+		int k;
+		double w;
+		read_binary(is, k);
+		read_binary(is, w);
+		samples.insert(samples.end(), make_pair(k, w));
+	}
+	return 0;
+}
+
 int merge_sorted_trans_items(vector<trans_item> &vx, const vector<trans_item> &vy, int mode, double single_exon_ratio)
 {
 	vector<trans_item> vz;
@@ -208,3 +241,59 @@ pair<bool, trans_item> transcript_set::query(const transcript &t) const
 	p.first = true;
 	return p;
 }
+
+// rename samples (e.g., after reordering), dropping unknown ones
+int transcript_set::remap_samples(const map<int, int> &m)
+{
+	for(auto &x : mt)
+	{
+		for(int k = 0; k < x.second.size(); k++)
+		{
+			map<int, double> z;
+			for(auto &p : x.second[k].samples)
+			{
+				auto it = m.find(p.first);
+				if(it == m.end()) continue;
+				if(z.find(it->second) == z.end() || z[it->second] < p.second) z[it->second] = p.second;
+			}
+			x.second[k].samples = std::move(z);
+		}
+	}
+	return 0;
+}
+
+int transcript_set::write(ostream &os) const
+{
+	write_binary_string(os, chrm);
+	write_binary(os, single_exon_overlap);
+	int64_t n = mt.size();
+	write_binary(os, n);
+	for(auto &x : mt)
+	{
+		write_binary(os, x.first);
+		int64_t m = x.second.size();
+		write_binary(os, m);
+		for(int k = 0; k < x.second.size(); k++) x.second[k].write(os);
+	}
+	return 0;
+}
+
+int transcript_set::read(istream &is)
+{
+	read_binary_string(is, chrm);
+	read_binary(is, single_exon_overlap);
+	int64_t n = 0;
+	read_binary(is, n);
+	mt.clear();
+	for(int64_t i = 0; i < n; i++)
+	{
+		size_t h;
+		int64_t m = 0;
+		read_binary(is, h);
+		read_binary(is, m);
+		vector<trans_item> v(m);
+		for(int64_t k = 0; k < m; k++) v[k].read(is);
+		mt.insert(mt.end(), make_pair(h, std::move(v)));
+	}
+	return 0;
+}
@@ -29,6 +29,8 @@ public:
 
 public:
 	int merge(const trans_item &ti, int mode);
+	int write(ostream &os) const;
+	int read(istream &is);
 };
 
 int merge_sorted_trans_items(vector<trans_item> &vx, const vector<trans_item> &vy, int mode, double single_exon_overlap);
@@ -52,6 +54,9 @@ public:
 	int print() const;
 	pair<bool, trans_item> query(const transcript &t) const;
 	vector<transcript> get_transcripts(int min_count) const;
+	int remap_samples(const map<int, int> &m);
+	int write(ostream &os) const;
+	int read(istream &is);
 };
 
 #endif
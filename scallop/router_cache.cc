@@ -0,0 +1,85 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#include "router_cache.h"
+
+router_cache::router_cache(splice_graph &g, hyper_set &h, MEI &ei, VE &ie, const parameters &c)
+	: cfg(c), gr(g), hs(h), e2i(ei), i2e(ie)
+{
+	hits = 0;
+	misses = 0;
+}
+
+const router_entry& router_cache::classify(int v)
+{
+	return query(v, false);
+}
+
+const router_entry& router_cache::build(int v)
+{
+	return query(v, true);
+}
+
+router_entry& router_cache::query(int v, bool b)
+{
+	MPII mpi = hs.get_routes(v, gr, e2i);
+
+	vector<double> key;
+	build_key(v, mpi, key);
+
+	if(v >= entries.size()) entries.resize(v + 1);
+	router_entry &x = entries[v];
+
+	if(x.key == key && (b == false || x.built == true))
+	{
+		hits++;
+		return x;
+	}
+
+	misses++;
+
+	router rt(v, gr, e2i, i2e, mpi, cfg);
+	rt.classify();
+	if(b == true) rt.build();
+
+	x.key = key;
+	x.built = b;
+	x.type = rt.type;
+	x.degree = rt.degree;
+	x.ratio = rt.ratio;
+	x.eqns = rt.eqns;
+	x.pe2w = rt.pe2w;
+	return x;
+}
+
+int router_cache::build_key(int v, const MPII &mpi, vector<double> &key)
+{
+	// a router only reads these, so equal keys give equal results
+	key.clear();
+	edge_iterator it1, it2;
+	PEEI pei;
+	for(pei = gr.in_edges(v), it1 = pei.first, it2 = pei.second; it1 != it2; it1++)
+	{
+		key.push_back(e2i[*it1]);
+		key.push_back(gr.get_edge_weight(*it1));
+		key.push_back(gr.get_edge_info(*it1).strand);
+	}
+	key.push_back(-1);
+	for(pei = gr.out_edges(v), it1 = pei.first, it2 = pei.second; it1 != it2; it1++)
+	{
+		key.push_back(e2i[*it1]);
+		key.push_back(gr.get_edge_weight(*it1));
+		key.push_back(gr.get_edge_info(*it1).strand);
+	}
+	key.push_back(-1);
+	for(MPII::const_iterator it = mpi.begin(); it != mpi.end(); it++)
+	{
+		key.push_back(it->first.first);
+		key.push_back(it->first.second);
+		key.push_back(it->second);
+	}
+	return 0;
+}
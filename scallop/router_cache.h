@@ -0,0 +1,56 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#ifndef __ROUTER_CACHE_H__
+#define __ROUTER_CACHE_H__
+
+#include <vector>
+#include "splice_graph.h"
+#include "hyper_set.h"
+#include "router.h"
+#include "parameters.h"
+
+using namespace std;
+
+class router_entry
+{
+public:
+	vector<double> key;			// adjacent edges, weights, strands, and routes
+	bool built;					// whether build() has been called
+	int type;					// as router::type
+	int degree;					// as router::degree
+	double ratio;				// as router::ratio
+	vector<equation> eqns;		// as router::eqns
+	MPID pe2w;					// as router::pe2w
+};
+
+// routers of vertices whose neighborhood did not change since
+// the last query are reused instead of being classified again
+class router_cache
+{
+public:
+	router_cache(splice_graph &g, hyper_set &h, MEI &ei, VE &ie, const parameters &c);
+
+public:
+	const parameters &cfg;
+	splice_graph &gr;
+	hyper_set &hs;
+	MEI &e2i;
+	VE &i2e;
+	vector<router_entry> entries;	// indexed by vertex
+	int hits;
+	int misses;
+
+public:
+	const router_entry& classify(int v);
+	const router_entry& build(int v);
+
+private:
+	router_entry& query(int v, bool b);
+	int build_key(int v, const MPII &mpi, vector<double> &key);
+};
+
+#endif
@@ -17,7 +17,7 @@ See LICENSE for licensing.
 #include <algorithm>
 
 scallop::scallop(splice_graph &g, hyper_set &h, const parameters &c)
-	: gr(g), hs(h), cfg(c)
+	: gr(g), hs(h), cfg(c), rc(g, h, e2i, i2e, c)
 {
 	round = 0;
 	//gr.draw(gr.gid + "." + tostring(round++) + ".tex");
@@ -158,6 +158,7 @@ int scallop::assemble()
 
 	if(cfg.verbose >= 2) 
 	{
+		printf("router cache of bundle %s: %d hits, %d misses\n", gr.gid.c_str(), rc.hits, rc.misses);
 		for(int i = 0; i < paths.size(); i++) paths[i].print(i);
 		printf("finish assemble bundle %s\n\n", gr.gid.c_str());
 	}
@@ -904,15 +905,11 @@ bool scallop::resolve_splittable_vertex(int type, int degree, double max_ratio)
 		if(gr.in_degree(i) <= 1) continue;
 		if(gr.out_degree(i) <= 1) continue;
 
-		MPII mpi = hs.get_routes(i, gr, e2i);
-		router rt(i, gr, e2i, i2e, mpi, cfg);
-		rt.classify();
-
-		if(rt.type != type) continue;
-		if(rt.degree > degree) continue;
-
-		rt.build();
+		const router_entry &rx = rc.classify(i);
+		if(rx.type != type) continue;
+		if(rx.degree > degree) continue;
 
+		const router_entry &rt = rc.build(i);
 
 		assert(rt.eqns.size() == 2);
 
@@ -956,25 +953,23 @@ bool scallop::resolve_unsplittable_vertex(int type, int degree, double max_ratio
 		if(gr.in_degree(i) <= 1) continue;
 		if(gr.out_degree(i) <= 1) continue;
 
-		MPII mpi = hs.get_routes(i, gr, e2i);
-		router rt(i, gr, e2i, i2e, mpi, cfg);
-		rt.classify();
+		const router_entry &rx = rc.classify(i);
 
 		if(cfg.verbose >= 2) printf("catch unsplittable vertex, type = %d, degree = %d, vertex = %d, %d-%d, ratio = %.5lf, degree = (%d, %d)\n",
-				rt.type, rt.degree, i, gr.get_vertex_info(i).lpos, gr.get_vertex_info(i).rpos, rt.ratio, gr.in_degree(i), gr.out_degree(i));
+				rx.type, rx.degree, i, gr.get_vertex_info(i).lpos, gr.get_vertex_info(i).rpos, rx.ratio, gr.in_degree(i), gr.out_degree(i));
 
-		if(rt.type != type) continue;
-		if(rt.degree > degree) continue;
+		if(rx.type != type) continue;
+		if(rx.degree > degree) continue;
 
-		rt.build();
-		//rt.print();
+		const router_entry &rt = rc.build(i);
 
 		if(rt.ratio < 0.01)
 		{
 			if(cfg.verbose >= 2) printf("resolve unsplittable vertex, type = %d, degree = %d, vertex = %d, %d-%d, ratio = %.3lf, degree = (%d, %d)\n",
 					type, degree, i, gr.get_vertex_info(i).lpos, gr.get_vertex_info(i).rpos, rt.ratio, gr.in_degree(i), gr.out_degree(i));
 
-			decompose_vertex_extend(i, rt.pe2w);
+			MPID pw = rt.pe2w;
+			decompose_vertex_extend(i, pw);
 			flag = true;
 			continue;
 		}
@@ -1214,9 +1209,7 @@ bool scallop::resolve_mixed_vertex(int type)
 		if(gr.in_degree(i) <= 0) continue;
 		if(gr.mixed_strand_vertex(i) == false) continue;
 
-		MPII mpi = hs.get_routes(i, gr, e2i);
-		router rt(i, gr, e2i, i2e, mpi, cfg);
-		rt.classify();
+		const router_entry &rt = rc.classify(i);
 		if(rt.type != type) continue;
 
 		root = i;
@@ -1244,7 +1237,8 @@ bool scallop::resolve_mixed_vertex(int type)
 		if(type == MIXED_SPLITTABLE)
 		{
 			assert(rt.eqns.size() >= 1);
-			split_vertex(root, rt.eqns[0].s, rt.eqns[0].t);
+			equation eqn = rt.eqns[0];
+			split_vertex(root, eqn.s, eqn.t);
 			return true;
 		}
 
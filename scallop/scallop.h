@@ -11,6 +11,7 @@ See LICENSE for licensing.
 #include "hyper_set.h"
 #include "equation.h"
 #include "router.h"
+#include "router_cache.h"
 #include "path.h"
 #include "parameters.h"
 
@@ -48,6 +49,7 @@ public:
 	vector<int> v2v;					// vertex map
 	int round;							// iteration
 	set<int> nonzeroset;				// vertices with degree >= 1
+	router_cache rc;					// routers of unchanged vertices
 	vector<path> paths;					// predicted paths
 	vector<transcript> trsts;			// predicted transcripts
 
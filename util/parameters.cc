@@ -26,10 +26,27 @@ parameters::parameters()
 	chrm_list_string = "";
 	chrm_list_file = "";
 	profile_dir = "";
+	spill_dir = "";
+	window_manifest = "";
+	write_window_manifest = "";
+	merge_gtf_list = "";
+	write_bundle_store = "";
+	read_bundle_store = "";
+	cohort_dir = "";
+	window_size = 0;
+	sort_bridged_bam = false;
+	bridged_bam_threads = 2;
+	bridged_bam_buffer = 512;
+	decode_threads = 4;
+	read_ahead_batches = 8;
+	bridge_queue_size = 16;
+	weighted_hits = false;
 	verbose = 1;
 	algo = "aletsch";
 	version = "1.0.3";
 	max_threads = 10;
+	max_pipeline_memory = 4096;
+	max_batch_reads = 1000000;
 	profile_only = false;
 	boost_precision = false;
 
@@ -62,6 +79,8 @@ parameters::parameters()
 	max_preview_spliced_reads = 50000;
 	min_preview_spliced_reads = 5000;
 	preview_infer_ratio = 0.8;
+	preview_regions = 200;
+	preview_region_length = 1000000;
 	
 	// for identifying subgraphs
 	min_subregion_gap = 15;
@@ -171,6 +190,79 @@ int parameters::parse_arguments(int argc, const char ** argv, int data_type)
 			profile_dir = string(argv[i + 1]);
 			i++;
 		}
+		else if(string(argv[i]) == "--spill_dir")
+		{
+			spill_dir = string(argv[i + 1]);
+			i++;
+		}
+		else if(string(argv[i]) == "--sort_bridged_bam")
+		{
+			sort_bridged_bam = true;
+		}
+		else if(string(argv[i]) == "--bridged_bam_threads")
+		{
+			bridged_bam_threads = atoi(argv[i + 1]);
+			i++;
+		}
+		else if(string(argv[i]) == "--bridged_bam_buffer")
+		{
+			bridged_bam_buffer = atoi(argv[i + 1]);
+			i++;
+		}
+		else if(string(argv[i]) == "--decode_threads")
+		{
+			decode_threads = atoi(argv[i + 1]);
+			i++;
+		}
+		else if(string(argv[i]) == "--read_ahead_batches")
+		{
+			read_ahead_batches = atoi(argv[i + 1]);
+			i++;
+		}
+		else if(string(argv[i]) == "--weighted_hits")
+		{
+			weighted_hits = true;
+		}
+		else if(string(argv[i]) == "--bridge_queue_size")
+		{
+			bridge_queue_size = atoi(argv[i + 1]);
+			i++;
+		}
+		else if(string(argv[i]) == "--window_size")
+		{
+			window_size = atoi(argv[i + 1]);
+			i++;
+		}
+		else if(string(argv[i]) == "--window_manifest")
+		{
+			window_manifest = string(argv[i + 1]);
+			i++;
+		}
+		else if(string(argv[i]) == "--write_window_manifest")
+		{
+			write_window_manifest = string(argv[i + 1]);
+			i++;
+		}
+		else if(string(argv[i]) == "--merge_gtf_list")
+		{
+			merge_gtf_list = string(argv[i + 1]);
+			i++;
+		}
+		else if(string(argv[i]) == "--write_bundle_store")
+		{
+			write_bundle_store = string(argv[i + 1]);
+			i++;
+		}
+		else if(string(argv[i]) == "--read_bundle_store")
+		{
+			read_bundle_store = string(argv[i + 1]);
+			i++;
+		}
+		else if(string(argv[i]) == "--cohort_dir")
+		{
+			cohort_dir = string(argv[i + 1]);
+			i++;
+		}
 		else if(string(argv[i]) == "-t")
 		{
 			max_threads = atoi(argv[i + 1]);
@@ -181,6 +273,16 @@ int parameters::parse_arguments(int argc, const char ** argv, int data_type)
 			max_threads = atoi(argv[i + 1]);
 			i++;
 		}
+		else if(string(argv[i]) == "--max_pipeline_memory")
+		{
+			max_pipeline_memory = atoi(argv[i + 1]);
+			i++;
+		}
+		else if(string(argv[i]) == "--max_batch_reads")
+		{
+			max_batch_reads = atoi(argv[i + 1]);
+			i++;
+		}
 		else if(string(argv[i]) == "-s")
 		{
 			min_grouping_similarity = atof(argv[i + 1]);
@@ -426,6 +528,20 @@ int parameters::parse_arguments(int argc, const char ** argv, int data_type)
 			i++;
 			i++;
 		}
+		else if(string(argv[i]) == "--preview_regions")
+		{
+			int dt = atoi(argv[i + 1]);
+			if(dt == 0 || dt == data_type) preview_regions = atoi(argv[i + 2]);
+			i++;
+			i++;
+		}
+		else if(string(argv[i]) == "--preview_region_length")
+		{
+			int dt = atoi(argv[i + 1]);
+			if(dt == 0 || dt == data_type) preview_region_length = atoi(argv[i + 2]);
+			i++;
+			i++;
+		}
 
 		else if(string(argv[i]) == "--min_subregion_gap")
 		{
@@ -477,6 +593,11 @@ int parameters::parse_arguments(int argc, const char ** argv, int data_type)
 		min_surviving_edge_weight = 0.1 + min_transcript_coverage;
 	}
 
+	// merged samples of a cohort are read back from their kept bundles
+	// rather than their bams; bridged reads are only written from bams
+	if(cohort_dir != "" && write_bundle_store == "") write_bundle_store = cohort_dir;
+	if(cohort_dir != "" && read_bundle_store == "" && output_bridged_bam_dir == "") read_bundle_store = cohort_dir;
+
 	return 0;
 }
 
@@ -522,8 +643,25 @@ int parameters::print_help()
 	printf(" %-46s  %s\n", "-L/--chrm_list_file <string>",  "file with chromosomes that will be assembled, default: N/A (i.e., assemble all)");
 	printf(" %-46s  %s\n", "-d/--output_gtf_dir <string>",  "existing directory for individual transcripts, default: N/A");
 	printf(" %-46s  %s\n", "-b/--output_bridged_bam_dir <string>",  "existing directory for individual bridged alignments, default: N/A");
-	printf(" %-46s  %s\n", "-p/--profile_dir <string>",  "existing directory for saving/loading profiles of each samples, default: N/A");
+	printf(" %-46s  %s\n", "-p/--profile_dir <string>",  "existing directory caching profiles of samples (keyed by file identity, refreshed when changed), default: N/A");
+	printf(" %-46s  %s\n", "--spill_dir <string>",  "existing directory to spill reads of bundles until assembly, default: N/A (keep in memory)");
+	printf(" %-46s  %s\n", "--write_bundle_store <string>",  "existing directory to keep bridged bundles of each sample for later runs, default: N/A");
+	printf(" %-46s  %s\n", "--read_bundle_store <string>",  "directory of kept bundles, used instead of reading bams when up to date, default: N/A");
+	printf(" %-46s  %s\n", "--cohort_dir <string>",  "existing directory keeping merged results, so later runs only assemble what new samples touch; also the default bundle store, default: N/A");
+	printf(" %-46s  %s\n", "--sort_bridged_bam",  "write bridged alignments sorted by coordinate and indexed");
+	printf(" %-46s  %s\n", "--bridged_bam_threads <integer>",  "compression threads for each bridged bam, default: 2");
+	printf(" %-46s  %s\n", "--bridged_bam_buffer <integer>",  "memory (MB) for sorting each bridged bam before spilling, default: 512");
+	printf(" %-46s  %s\n", "--decode_threads <integer>",  "threads shared by all samples for decompressing input bams, 0 to disable, default: 4");
+	printf(" %-46s  %s\n", "--read_ahead_batches <integer>",  "batches of decoded alignments buffered ahead of bundling, 0 to disable, default: 8");
+	printf(" %-46s  %s\n", "--bridge_queue_size <integer>",  "closed bundles of one sample waiting to be bridged by other threads, 0 to bridge in the reader, default: 16");
+	printf(" %-46s  %s\n", "--weighted_hits",  "collapse identical alignments into weighted hits, ignored when writing bridged bams");
+	printf(" %-46s  %s\n", "--window_size <integer>",  "cut chromosomes into windows of at least this length at gaps of all samples (reads all samples once more), 0 to disable, default: 0");
+	printf(" %-46s  %s\n", "--write_window_manifest <string>",  "write windows (chrm, start, end) to this file and exit");
+	printf(" %-46s  %s\n", "--window_manifest <string>",  "only assemble the windows listed in this file, default: N/A");
+	printf(" %-46s  %s\n", "--merge_gtf_list <string>",  "concatenate the gtf files listed in this file (in order) into -o and exit; a second column names the -d directory of that run, merged into -d (needs -i)");
 	printf(" %-46s  %s\n", "-t/--max_threads <integer>",  "maximized number of threads, default: 10");
+	printf(" %-46s  %s\n", "--max_pipeline_memory <integer>",  "memory budget (MB) for overlapping chromosomes, 0 to process one by one, default: 4096");
+	printf(" %-46s  %s\n", "--max_batch_reads <integer>",  "pack small chromosomes into one unit up to this many reads (estimated from indices), 0 to disable, default: 1000000");
 	printf(" %-46s  %s\n", "-c/--max_group_size <integer>",  "the maximized number of splice graphs that will be combined, default: 20");
 	printf(" %-46s  %s\n", "-s/--min_grouping_similarity <float>",  "the minimized similarity for two graphs to be combined, default: 0.2");
 	printf(" %-46s  %s\n", "--min_bridging_score <float>",  "the minimum score for bridging a paired-end reads, default: 1.5");
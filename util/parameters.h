@@ -30,10 +30,27 @@ public:
 	string output_gtf_dir;
 	string output_bridged_bam_dir;
 	string profile_dir;
+	string spill_dir;
+	string window_manifest;
+	string write_window_manifest;
+	string merge_gtf_list;
+	string write_bundle_store;
+	string read_bundle_store;
+	string cohort_dir;
+	int32_t window_size;
+	bool sort_bridged_bam;
+	int bridged_bam_threads;
+	int bridged_bam_buffer;
+	int decode_threads;
+	int read_ahead_batches;
+	int bridge_queue_size;
+	bool weighted_hits;
 	int verbose;
 	string algo;
 	string version;
 	int max_threads;
+	int max_pipeline_memory;
+	int max_batch_reads;
 	bool profile_only;
 	bool boost_precision;
 
@@ -88,6 +105,8 @@ public:
 	int max_preview_spliced_reads;
 	int min_preview_spliced_reads;
 	double preview_infer_ratio;
+	int preview_regions;
+	int32_t preview_region_length;
 
 	// for identifying subgraphs
 	int32_t min_subregion_gap;
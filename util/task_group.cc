@@ -0,0 +1,34 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#include "task_group.h"
+
+task_group::task_group()
+{
+	pending = 0;
+}
+
+int task_group::add(int n)
+{
+	lock_guard<mutex> lk(lock);
+	pending += n;
+	return 0;
+}
+
+int task_group::finish()
+{
+	lock_guard<mutex> lk(lock);
+	pending--;
+	if(pending <= 0) cv.notify_all();
+	return 0;
+}
+
+int task_group::wait()
+{
+	unique_lock<mutex> lk(lock);
+	cv.wait(lk, [this]{ return pending <= 0; });
+	return 0;
+}
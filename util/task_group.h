@@ -0,0 +1,33 @@
+/*
+Part of aletsch
+(c) 2020 by Mingfu Shao, The Pennsylvania State University
+See LICENSE for licensing.
+*/
+
+#ifndef __TASK_GROUP_H__
+#define __TASK_GROUP_H__
+
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+// track a batch of tasks posted to a shared thread pool;
+// wait() must not be called from a thread of the same pool
+class task_group
+{
+public:
+	task_group();
+
+private:
+	int pending;
+	mutex lock;
+	condition_variable cv;
+
+public:
+	int add(int n);			// register n more tasks
+	int finish();			// called by each task when it completes
+	int wait();				// block until all registered tasks complete
+};
+
+#endif
@@ -24,6 +24,25 @@ vector<int> get_random_permutation(int n)
 }
 
 
+int write_binary_string(ostream &os, const string &s)
+{
+	int32_t n = s.size();
+	write_binary(os, n);
+	os.write(s.c_str(), n);
+	return 0;
+}
+
+int read_binary_string(istream &is, string &s)
+{
+	int32_t n = 0;
+	read_binary(is, n);
+	s.clear();
+	if(check_binary_count(is, n, 1) == false) return -1;
+	s.resize(n);
+	if(n >= 1) is.read(&s[0], n);
+	return 0;
+}
+
 size_t string_hash(const std::string& str)
 {
 	size_t hash = 1315423911;
@@ -334,6 +334,56 @@ bool overlap_two_sorted_sequences(const vector<T> &ref, const vector<T> &qry, ve
 	return true;
 }
 
+// binary io of plain data
+template<typename T>
+int write_binary(ostream &os, const T &x)
+{
+	os.write((const char*)(&x), sizeof(T));
+	return 0;
+}
+
+template<typename T>
+int read_binary(istream &is, T &x)
+{
+	is.read((char*)(&x), sizeof(T));
+	return 0;
+}
+
+template<typename T>
+int write_binary_vector(ostream &os, const vector<T> &v)
+{
+	int64_t n = v.size();
+	write_binary(os, n);
+	if(n >= 1) os.write((const char*)(v.data()), n * sizeof(T));
+	return 0;
+}
+
+// whether n items of at least s bytes each may follow in the stream;
+// a corrupt count fails the stream instead of being allocated
+inline bool check_binary_count(istream &is, int64_t n, int64_t s)
+{
+	if(is.fail() || n < 0) is.setstate(ios::failbit);
+	if(is.fail()) return false;
+	streamsize a = is.rdbuf()->in_avail();
+	if(a > 0 && n > a / s) is.setstate(ios::failbit);
+	return !is.fail();
+}
+
+template<typename T>
+int read_binary_vector(istream &is, vector<T> &v)
+{
+	int64_t n = 0;
+	read_binary(is, n);
+	v.clear();
+	if(check_binary_count(is, n, sizeof(T)) == false) return -1;
+	v.resize(n);
+	if(n >= 1) is.read((char*)(v.data()), n * sizeof(T));
+	return 0;
+}
+
+int write_binary_string(ostream &os, const string &s);
+int read_binary_string(istream &is, string &s);
+
 vector<int> get_random_permutation(int n);
 size_t string_hash(const std::string& str);
 size_t vector_hash(const vector<int32_t> &str);